@@ -0,0 +1,13 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+/*
+ * Call from the HID transport when a keyboard report has left its queue
+ * (USB IN transfer complete, BLE notification sent). With
+ * CONFIG_ZMK_TETRIS_HID_BACKPRESSURE the tetris renderer keeps at most
+ * CONFIG_ZMK_TETRIS_HID_HIGH_WATER reports in flight and resumes from here.
+ * Safe to call from any context.
+ */
+void zmk_tetris_hid_report_sent(void);
@@ -3,6 +3,7 @@
  */
 #define DT_DRV_COMPAT zmk_behavior_tetris
 
+#include <zephyr/device.h>
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 #include <zephyr/random/random.h>
@@ -14,6 +15,32 @@
 
 #include <dt-bindings/zmk/keys.h>
 
+#if IS_ENABLED(CONFIG_ZMK_TETRIS_DIRECT_HID)
+#include <zmk/endpoints.h>
+#include <zmk/hid.h>
+#include <zmk/keys.h>
+#endif
+
+/* host lock LED reports: flow control and delay calibration */
+#define TETRIS_LED_ACK \
+    (IS_ENABLED(CONFIG_ZMK_TETRIS_LED_FLOW_CONTROL) || IS_ENABLED(CONFIG_ZMK_TETRIS_CALIBRATION))
+
+#if TETRIS_LED_ACK
+#include <zmk/event_manager.h>
+#include <zmk/events/hid_indicators_changed.h>
+#include <zmk/hid_indicators.h>
+
+#define LED_SCROLL_LOCK BIT(2) /* HID LED report bit */
+#endif
+
+#if IS_ENABLED(CONFIG_ZMK_TETRIS_CALIBRATION) && IS_ENABLED(CONFIG_SETTINGS)
+#include <zephyr/settings/settings.h>
+#endif
+
+#if IS_ENABLED(CONFIG_ZMK_TETRIS_HID_BACKPRESSURE)
+#include <tetris/hid_pacing.h>
+#endif
+
 LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
 /* ==============================
@@ -30,7 +57,6 @@ LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
  */
 #define BOARD_TOP_LINE_INDEX 3
 
-#define MAX_UPDATE_LINES 16
 #define UPDATE_TEXT_MAX 32  /* score line etc */
 
 static uint16_t idle_before_fall_ms = 2000;
@@ -45,31 +71,176 @@ static uint16_t post_clear_spawn_delay_ms = 260;  // after rows cleared, before
 static uint16_t post_land_spawn_delay_ms  = 180;  // normal landing -> spawn delay
 static uint16_t post_hard_drop_delay_ms   = 260;  // hard drop landing -> spawn delay
 
-/* delays for editor ops (stability) */
-static uint32_t delay_for_char(char c) { return (c == '\n') ? 25 : 6; }
-static uint32_t delay_nav(void) { return 12; }
-static uint32_t delay_action(void) { return 18; }
+/* delays for editor ops (stability); DT draw-delay-* props, or calibrated */
+struct draw_delays {
+    uint16_t char_ms;
+    uint16_t enter_ms;
+    uint16_t nav_ms;
+    uint16_t action_ms;
+};
+
+static struct draw_delays draw_delay = { 6, 25, 12, 18 };
+
+static uint32_t delay_for_char(char c) { return (c == '\n') ? draw_delay.enter_ms : draw_delay.char_ms; }
+static uint32_t delay_nav(void) { return draw_delay.nav_ms; }
+static uint32_t delay_action(void) { return draw_delay.action_ms; }
 
 /* ==============================
  * Key helpers (event-based)
+ *
+ * Taps are queued as press/release events and sent one per work tick,
+ * KEY_HOLD_MS apart, so the system workqueue never sleeps.
  * ============================== */
+#define KEY_HOLD_MS 1
+#define KEY_QUEUE_MAX 4 /* mod + key, press and release */
+
 static inline void press(uint32_t keycode) {
     raise_zmk_keycode_state_changed_from_encoded(keycode, true, (uint32_t)k_uptime_get());
 }
 static inline void release(uint32_t keycode) {
     raise_zmk_keycode_state_changed_from_encoded(keycode, false, (uint32_t)k_uptime_get());
 }
-static inline void tap(uint32_t keycode) {
-    press(keycode);
-    k_msleep(1);
-    release(keycode);
+
+struct key_event {
+    uint32_t keycode;
+    bool pressed;
+};
+
+#if IS_ENABLED(CONFIG_ZMK_TETRIS_HID_BACKPRESSURE)
+/* hid_pacing: the transport's acks seen so far; see "HID report backpressure" */
+enum { HID_PACING_OFF = 0, HID_PACING_ON, HID_PACING_BROKEN };
+static atomic_t hid_pacing;
+static atomic_t hid_in_flight; /* reports sent, not yet acked by the transport */
+static inline void count_report(void) {
+    if (atomic_get(&hid_pacing) == HID_PACING_ON) atomic_inc(&hid_in_flight);
+}
+#else
+static inline void count_report(void) {}
+#endif
+
+static struct {
+    struct key_event ev[KEY_QUEUE_MAX];
+    uint8_t len;
+    uint8_t pos;
+} keyq;
+
+static inline bool keyq_idle(void) { return keyq.pos >= keyq.len; }
+
+static void keyq_push(uint32_t keycode, bool pressed) {
+    if (keyq_idle()) keyq.len = keyq.pos = 0;
+    if (keyq.len >= KEY_QUEUE_MAX) return;
+    keyq.ev[keyq.len].keycode = keycode;
+    keyq.ev[keyq.len].pressed = pressed;
+    keyq.len++;
+}
+
+static inline void queue_press(uint32_t keycode) { keyq_push(keycode, true); }
+static inline void queue_release(uint32_t keycode) { keyq_push(keycode, false); }
+static inline void queue_tap(uint32_t keycode) {
+    queue_press(keycode);
+    queue_release(keycode);
+}
+static inline void queue_tap_with_mod(uint32_t mod, uint32_t key) {
+    queue_press(mod);
+    queue_tap(key);
+    queue_release(mod);
+}
+
+#if IS_ENABLED(CONFIG_ZMK_TETRIS_DIRECT_HID)
+/* Direct HID path: update the keyboard report ourselves, skipping the event
+ * bus. A plain key's release is held back and sent in the same report as the
+ * next press, so a typed row costs about one report per char instead of two.
+ */
+static uint32_t hid_held; /* released but not yet reported, 0: none */
+
+static bool hid_plain_key(uint32_t keycode) {
+    return ZMK_HID_USAGE_PAGE(keycode) == HID_USAGE_KEY && SELECT_MODS(keycode) == 0 &&
+           !is_mod(HID_USAGE_KEY, ZMK_HID_USAGE_ID(keycode));
+}
+
+static void hid_apply(uint32_t keycode, bool pressed) {
+    zmk_mod_flags_t mods = SELECT_MODS(keycode);
+    if (pressed) {
+        if (mods) zmk_hid_register_mods(mods);
+        zmk_hid_keyboard_press(ZMK_HID_USAGE_ID(keycode));
+    } else {
+        zmk_hid_keyboard_release(ZMK_HID_USAGE_ID(keycode));
+        if (mods) zmk_hid_unregister_mods(mods);
+    }
+}
+
+static void hid_send_report(void) {
+    count_report();
+    zmk_endpoints_send_report(HID_USAGE_KEY);
+}
+
+static void key_send(uint32_t keycode, bool pressed) {
+    if (hid_held) {
+        /* same key again must be seen as a new press */
+        bool merge = pressed && hid_plain_key(keycode) &&
+                     ZMK_HID_USAGE_ID(keycode) != ZMK_HID_USAGE_ID(hid_held);
+        hid_apply(hid_held, false);
+        hid_held = 0;
+        if (!merge) hid_send_report();
+    }
+    if (!pressed && hid_plain_key(keycode)) {
+        hid_held = keycode;
+        return;
+    }
+    hid_apply(keycode, pressed);
+    hid_send_report();
+}
+
+/* report a held-back release, if any */
+static void key_flush(void) {
+    if (!hid_held) return;
+    hid_apply(hid_held, false);
+    hid_held = 0;
+    hid_send_report();
+}
+#else
+static void key_send(uint32_t keycode, bool pressed) {
+    count_report();
+    if (pressed) press(keycode);
+    else release(keycode);
+}
+
+static inline void key_flush(void) {}
+#endif
+
+/* Keys we pressed and have not released: Shift held across a selection,
+ * the modifier of a half-sent chord. */
+static struct {
+    uint32_t keycode[KEY_QUEUE_MAX];
+    uint8_t n;
+} keys_down;
+
+static void keys_down_note(uint32_t keycode, bool pressed) {
+    if (pressed) {
+        if (keys_down.n < KEY_QUEUE_MAX) keys_down.keycode[keys_down.n++] = keycode;
+        return;
+    }
+    for (uint8_t i = 0; i < keys_down.n; i++) {
+        if (keys_down.keycode[i] != keycode) continue;
+        for (uint8_t k = i + 1; k < keys_down.n; k++) keys_down.keycode[k - 1] = keys_down.keycode[k];
+        keys_down.n--;
+        return;
+    }
+}
+
+/* send the next queued event */
+static void keyq_send_next(void) {
+    struct key_event *e = &keyq.ev[keyq.pos++];
+    keys_down_note(e->keycode, e->pressed);
+    key_send(e->keycode, e->pressed);
 }
-static inline void tap_with_mod(uint32_t mod, uint32_t key) {
-    press(mod);
-    k_msleep(1);
-    tap(key);
-    k_msleep(1);
-    release(mod);
+
+/* Drop the queue and release everything still held, last pressed first,
+ * so a cancel can never leave a modifier down on the host. */
+static void keyq_abort(void) {
+    keyq.len = keyq.pos = 0;
+    while (keys_down.n > 0) key_send(keys_down.keycode[--keys_down.n], false);
+    key_flush();
 }
 
 /* ==============================
@@ -131,7 +302,25 @@ static bool char_to_keycode(char c, uint32_t *out) {
 /* ==============================
  * Game state (locked board + falling piece)
  * ============================== */
-static uint8_t board_locked[BOARD_H][BOARD_W]; // 0/1
+/* one bit-row per line, bit c = column c */
+#define ROW_CELLS ((uint16_t)((1u << BOARD_W) - 1))
+BUILD_ASSERT(BOARD_W <= 16, "board rows are uint16_t");
+static uint16_t board_rows[BOARD_H];
+
+/* the same cells by column, bit r = row r; the landing index */
+BUILD_ASSERT(BOARD_H < 16, "board columns are uint16_t plus a floor bit");
+static uint16_t board_cols[BOARD_W];
+
+/* board rows whose text may differ from the last frame; set by every game
+ * mutation, consumed by the renderer */
+#define ROWS_ALL ((uint16_t)((1u << BOARD_H) - 1))
+static uint16_t rows_dirty = ROWS_ALL;
+
+static void board_wipe(void) {
+    for (int r = 0; r < BOARD_H; r++) board_rows[r] = 0;
+    for (int c = 0; c < BOARD_W; c++) board_cols[c] = 0;
+    rows_dirty = ROWS_ALL;
+}
 
 enum tetromino {
     TET_I = 0,
@@ -163,19 +352,13 @@ static uint16_t lines_cleared_total;
 static int8_t hold_type;     /* -1 none */
 static bool hold_used;       /* one hold per piece */
 
-/* queued inputs while rendering / clear animation / spawn delay */
-static int  pending_dx;
-static int  pending_rot_cw;
-static int  pending_rot_ccw;
-static bool pending_hard_drop;
-static int  pending_soft_drop;
-static bool pending_hold;
 static uint32_t last_input_ms;
 
 /* line clear state */
 static bool clearing;
 static uint16_t clear_mask;   // row bits
 static uint8_t clear_step;
+static bool clear_waits_render; /* step due, its phase not on screen yet */
 
 /* spawn delay */
 static uint16_t pending_spawn_delay_ms;
@@ -232,7 +415,9 @@ static char tet_char(int t) {
  * 4x4 masks (bit 0 = (0,0), bit 15 = (3,3))
  * ============================== */
 #define BIT_AT(r, c) ((uint16_t)(1u << (((r) * 4) + (c))))
-static inline bool mask_has(uint16_t m, int r, int c) { return (m & BIT_AT(r, c)) != 0; }
+
+/* The masks are row-major nibbles, so row r of a (type, rot) is a shift. */
+static inline uint16_t shape_row(uint16_t m, int r) { return (uint16_t)((m >> (r * 4)) & 0xF); }
 
 static const uint16_t SHAPE[TET_COUNT][4] = {
     /* I */
@@ -294,25 +479,86 @@ static const uint16_t SHAPE[TET_COUNT][4] = {
     },
 };
 
+/* rows the falling piece occupies (shown or not) */
+static void mark_piece_dirty(void) {
+    uint16_t m = SHAPE[falling.type][falling.rot & 3];
+    for (int r = 0; r < 4; r++) {
+        int br = falling.y + r;
+        if (shape_row(m, r) && br >= 0 && br < BOARD_H) rows_dirty |= (uint16_t)(1u << br);
+    }
+}
+
+static void move_falling(int x, int y, uint8_t rot) {
+    mark_piece_dirty();
+    falling.x = x;
+    falling.y = y;
+    falling.rot = rot;
+    mark_piece_dirty();
+}
+
 /* ==============================
  * Collision / placement
+ *
+ * Tested in a 32-bit frame with ROW_WALL wall bits left of column 0 and
+ * everything right of the last column set, so one AND per piece row covers
+ * the walls and the locked cells.
  * ============================== */
+#define ROW_WALL 3
+#define ROW_FRAME_WALLS (~((uint32_t)ROW_CELLS << ROW_WALL))
+
 static bool can_place(uint8_t type, uint8_t rot, int x, int y) {
     uint16_t m = SHAPE[type][rot & 3];
 
+    /* every column of the mask is left of the board */
+    if (x < -ROW_WALL) return false;
+
     for (int r = 0; r < 4; r++) {
-        for (int c = 0; c < 4; c++) {
-            if (!mask_has(m, r, c)) continue;
+        uint32_t bits = (uint32_t)shape_row(m, r) << (x + ROW_WALL);
+        if (!bits) continue;
 
-            int br = y + r;
-            int bc = x + c;
-            if (bc < 0 || bc >= BOARD_W || br < 0 || br >= BOARD_H) return false;
-            if (board_locked[br][bc]) return false;
-        }
+        int br = y + r;
+        if (br < 0 || br >= BOARD_H) return false;
+        uint32_t frame = ((uint32_t)board_rows[br] << ROW_WALL) | ROW_FRAME_WALLS;
+        if (frame & bits) return false;
     }
     return true;
 }
 
+/* lowest mask row with a cell in column c, -1: empty column */
+static int shape_col_bottom(uint16_t m, int c) {
+    for (int r = 3; r >= 0; r--) {
+        if (shape_row(m, r) & (1u << c)) return r;
+    }
+    return -1;
+}
+
+/* Rows a piece at a valid (x, y) can still fall: per column, the distance
+ * from its bottom cell to the next locked cell below (or the floor). Holes
+ * under overhangs count, the column masks hold every cell. */
+static int drop_distance(uint8_t type, uint8_t rot, int x, int y) {
+    uint16_t m = SHAPE[type][rot & 3];
+    int dist = BOARD_H;
+
+    for (int c = 0; c < 4; c++) {
+        int bottom = shape_col_bottom(m, c);
+        if (bottom < 0) continue;
+
+        uint32_t below = ((uint32_t)board_cols[x + c] | BIT(BOARD_H)) >> (y + bottom + 1);
+        dist = MIN(dist, (int)find_lsb_set(below) - 1);
+    }
+    return dist;
+}
+
+/* cells of row `row` covered by a piece at (x, y); off-board parts dropped */
+static uint16_t piece_row_cells(uint16_t m, int x, int y, int row) {
+    int r = row - y;
+    if (r < 0 || r >= 4) return 0;
+
+    uint16_t nib = shape_row(m, r);
+    uint32_t bits = (x >= 0) ? ((uint32_t)nib << x) : ((uint32_t)nib >> -x);
+    return (uint16_t)(bits & ROW_CELLS);
+}
+
 /* ==============================
  * Wall kick (SRS-like) CW + CCW
  * ============================== */
@@ -348,7 +594,7 @@ static bool try_rotate(int dir /* +1 CW, -1 CCW */) {
     uint8_t r1 = (dir > 0) ? ((r0 + 1) & 3) : ((r0 + 3) & 3);
 
     if (type == TET_O) {
-        if (can_place(type, r1, falling.x, falling.y)) { falling.rot = r1; return true; }
+        if (can_place(type, r1, falling.x, falling.y)) { move_falling(falling.x, falling.y, r1); return true; }
         return false;
     }
 
@@ -360,9 +606,7 @@ static bool try_rotate(int dir /* +1 CW, -1 CCW */) {
         int nx = falling.x + kicks[i][0];
         int ny = falling.y + kicks[i][1];
         if (can_place(type, r1, nx, ny)) {
-            falling.x = nx;
-            falling.y = ny;
-            falling.rot = r1;
+            move_falling(nx, ny, r1);
             return true;
         }
     }
@@ -372,6 +616,8 @@ static bool try_rotate(int dir /* +1 CW, -1 CCW */) {
 /* ==============================
  * Score line builder: "s 00000 l 000 n t k l"
  * ============================== */
+#define SCORE_LINE_LEN 22
+
 static char score_prev[UPDATE_TEXT_MAX];
 static char score_next[UPDATE_TEXT_MAX];
 
@@ -422,24 +668,21 @@ static bool score_equals(void) {
     }
     return true;
 }
-static void commit_score_line(void) {
-    for (int i = 0; i < UPDATE_TEXT_MAX; i++) {
-        score_prev[i] = score_next[i];
-        if (score_next[i] == '\0') break;
-    }
-}
 
 /* ==============================
  * Lock / clear / spawn
  * ============================== */
 static void lock_falling(void) {
     uint16_t m = SHAPE[falling.type][falling.rot & 3];
+    mark_piece_dirty();
     for (int r = 0; r < 4; r++) {
-        for (int c = 0; c < 4; c++) {
-            if (!mask_has(m, r, c)) continue;
-            int br = falling.y + r;
-            int bc = falling.x + c;
-            if (br >= 0 && br < BOARD_H && bc >= 0 && bc < BOARD_W) board_locked[br][bc] = 1;
+        int br = falling.y + r;
+        if (br < 0 || br >= BOARD_H) continue;
+
+        uint16_t cells = piece_row_cells(m, falling.x, falling.y, br);
+        board_rows[br] |= cells;
+        for (int c = 0; c < BOARD_W; c++) {
+            if (cells & (1u << c)) board_cols[c] |= (uint16_t)(1u << br);
         }
     }
 }
@@ -447,11 +690,7 @@ static void lock_falling(void) {
 static uint16_t detect_full_lines(void) {
     uint16_t mask = 0;
     for (int r = 0; r < BOARD_H; r++) {
-        bool full = true;
-        for (int c = 0; c < BOARD_W; c++) {
-            if (!board_locked[r][c]) { full = false; break; }
-        }
-        if (full) mask |= (1u << r);
+        if (board_rows[r] == ROW_CELLS) mask |= (1u << r);
     }
     return mask;
 }
@@ -465,15 +704,27 @@ static uint8_t popcount16(uint16_t x) {
 static void apply_line_clear(uint16_t mask) {
     if (!mask) return;
 
+    /* every row down to the lowest cleared one changes */
+    rows_dirty |= (uint16_t)(BIT(find_msb_set(mask)) - 1);
+
     int dst = BOARD_H - 1;
     for (int src = BOARD_H - 1; src >= 0; src--) {
         if (mask & (1u << src)) continue;
-        if (dst != src) {
-            for (int c = 0; c < BOARD_W; c++) board_locked[dst][c] = board_locked[src][c];
+        board_rows[dst--] = board_rows[src];
+    }
+    for (int r = dst; r >= 0; r--) board_rows[r] = 0;
+
+    /* columns: shift the masks in place for each cleared row, the rows
+     * above it move down one; going top-down keeps the lower cleared
+     * indices valid */
+    for (uint16_t m = mask; m; m &= (uint16_t)(m - 1)) {
+        int r = (int)find_lsb_set(m) - 1;
+        uint16_t above = (uint16_t)((1u << r) - 1);
+        for (int c = 0; c < BOARD_W; c++) {
+            uint16_t col = board_cols[c];
+            board_cols[c] = (uint16_t)((col & ~(above | (1u << r))) | ((col & above) << 1));
         }
-        dst--;
     }
-    for (int r = dst; r >= 0; r--) for (int c = 0; c < BOARD_W; c++) board_locked[r][c] = 0;
 }
 
 static void spawn_piece(void) {
@@ -484,7 +735,7 @@ static void spawn_piece(void) {
 
     if (!can_place(falling.type, falling.rot, falling.x, falling.y)) {
         /* demo: wipe board on gameover */
-        for (int r = 0; r < BOARD_H; r++) for (int c = 0; c < BOARD_W; c++) board_locked[r][c] = 0;
+        board_wipe();
 
         /* reset bag/hold too */
         refill_and_shuffle_bag();
@@ -499,6 +750,7 @@ static void spawn_piece(void) {
 
     /* new falling piece allows hold again */
     hold_used = false;
+    mark_piece_dirty();
 }
 
 /* Keep operation:
@@ -510,6 +762,7 @@ static void do_hold_action(void) {
     if (hold_used) return;
 
     has_falling = false; /* hide while we swap to avoid visual glitch */
+    mark_piece_dirty();
 
     if (hold_type < 0) {
         hold_type = (int8_t)falling.type;
@@ -522,10 +775,11 @@ static void do_hold_action(void) {
         falling.rot = 0;
         falling.x = 3;
         falling.y = 0;
+        mark_piece_dirty();
 
         if (!can_place(falling.type, falling.rot, falling.x, falling.y)) {
             /* treat as gameover-like: wipe board and reset */
-            for (int r = 0; r < BOARD_H; r++) for (int c = 0; c < BOARD_W; c++) board_locked[r][c] = 0;
+            board_wipe();
             refill_and_shuffle_bag();
             hold_type = -1;
             hold_used = false;
@@ -538,408 +792,1860 @@ static void do_hold_action(void) {
 }
 
 /* ==============================
- * Renderer: diff lines
+ * Renderer: span motions (VS Code cursor model)
+ *
+ * A dirty line is usually only a few cells different from what the editor
+ * already shows, so instead of retyping it we move to the first changed
+ * column, select up to the last changed one and type just that span.
+ *
+ * Word jumps follow VS Code's Ctrl+Left/Right: whitespace is skipped, then
+ * the cursor runs over one class of characters (separators like '.' / '='
+ * vs. regular ones like 'x').
  * ============================== */
-struct update_line {
-    int line_index;
-    char text[UPDATE_TEXT_MAX];
-};
-
-static char render_prev[BOARD_H][BOARD_W + 2];
-static char render_next[BOARD_H][BOARD_W + 2];
+enum motion_anchor { MOT_FROM_CURSOR = 0, MOT_FROM_HOME, MOT_FROM_END };
 
-static void build_row_string(int row, char out[BOARD_W + 2]) {
-    /* clear effect overrides; do NOT show next piece while clearing */
-    if (clearing && (clear_mask & (1u << row))) {
-        bool on = ((clear_step % 2) == 0);
-        for (int c = 0; c < BOARD_W; c++) out[c] = on ? '=' : '.';
-        out[BOARD_W] = ' ';
-        out[BOARD_W + 1] = '\0';
-        return;
-    }
+struct motion {
+    uint8_t anchor;     /* enum motion_anchor */
+    uint8_t jumps;      /* Ctrl+Left/Right taps */
+    int8_t jump_dir;    /* +1 right, -1 left */
+    int8_t fine;        /* plain Left/Right taps after the jumps, signed */
+};
 
-    for (int c = 0; c < BOARD_W; c++) out[c] = board_locked[row][c] ? 'x' : '.';
+static int char_class(char c) {
+    if (c == ' ') return 0;
+    if (c == '.' || c == '=' || c == '-') return 1;
+    return 2;
+}
 
-    /* overlay falling only if allowed */
-    if (has_falling && !clearing) {
-        uint16_t m = SHAPE[falling.type][falling.rot & 3];
-        for (int r = 0; r < 4; r++) {
-            int br = falling.y + r;
-            if (br != row) continue;
-            for (int c = 0; c < 4; c++) {
-                if (!mask_has(m, r, c)) continue;
-                int bc = falling.x + c;
-                if (bc >= 0 && bc < BOARD_W) out[bc] = 'x';
-            }
+static int word_jump(const char *text, int len, int pos, int dir) {
+    if (dir > 0) {
+        while (pos < len && char_class(text[pos]) == 0) pos++;
+        if (pos < len) {
+            int k = char_class(text[pos]);
+            while (pos < len && char_class(text[pos]) == k) pos++;
+        }
+    } else {
+        while (pos > 0 && char_class(text[pos - 1]) == 0) pos--;
+        if (pos > 0) {
+            int k = char_class(text[pos - 1]);
+            while (pos > 0 && char_class(text[pos - 1]) == k) pos--;
         }
     }
-
-    out[BOARD_W] = ' ';
-    out[BOARD_W + 1] = '\0';
+    return pos;
 }
 
-static void rebuild_render_next(void) {
-    for (int r = 0; r < BOARD_H; r++) build_row_string(r, render_next[r]);
+static int motion_cost(const struct motion *m) {
+    int fine = m->fine < 0 ? -m->fine : m->fine;
+    return (m->anchor != MOT_FROM_CURSOR ? 1 : 0) + m->jumps + fine;
 }
 
-static bool row_equals(const char *a, const char *b) {
-    for (int i = 0; i < BOARD_W + 2; i++) {
-        if (a[i] != b[i]) return false;
-        if (a[i] == '\0') break;
+/* cheapest key sequence moving the cursor from `from` to `to` within `text`
+ * (from < 0: column unknown, must start with Home/End) */
+static void plan_motion(const char *text, int len, int from, int to, struct motion *out) {
+    static const uint8_t anchors[] = { MOT_FROM_CURSOR, MOT_FROM_HOME, MOT_FROM_END };
+    int best = -1;
+
+    for (size_t a = 0; a < sizeof(anchors); a++) {
+        int start = from;
+        if (anchors[a] == MOT_FROM_HOME) start = 0;
+        else if (anchors[a] == MOT_FROM_END) start = len;
+        if (anchors[a] == MOT_FROM_CURSOR && from < 0) continue;
+        if (anchors[a] != MOT_FROM_CURSOR && start == from) continue;
+
+        int dir = (to >= start) ? +1 : -1;
+        int pos = start;
+        for (int k = 0; k <= len; k++) {
+            struct motion m = { anchors[a], (uint8_t)k, (int8_t)dir, (int8_t)(to - pos) };
+            int cost = motion_cost(&m);
+            if (best < 0 || cost < best) {
+                best = cost;
+                *out = m;
+            }
+            int next = word_jump(text, len, pos, dir);
+            if (next == pos || (dir > 0 ? next > to + best : next < to - best)) break;
+            pos = next;
+        }
     }
-    return true;
 }
 
-static uint8_t make_board_diff(struct update_line out[MAX_UPDATE_LINES]) {
-    uint8_t n = 0;
-    for (int r = 0; r < BOARD_H; r++) {
-        if (row_equals(render_prev[r], render_next[r])) continue;
-        if (n >= MAX_UPDATE_LINES) break;
+/* ==============================
+ * Renderer: editor cursor tracking
+ *
+ * The renderer is the only thing typing into the editor, so after each
+ * script we know where the cursor ended up and can reach the next dirty
+ * line with relative Up/Down instead of Ctrl+Home + N x Down.
+ * `want` is VS Code's sticky column for vertical moves.
+ * ============================== */
+#define LAST_LINE_INDEX (BOARD_TOP_LINE_INDEX + BOARD_H) /* empty line after the board */
 
-        out[n].line_index = BOARD_TOP_LINE_INDEX + r;
+enum nav_anchor { NAV_RELATIVE = 0, NAV_DOC_START, NAV_DOC_END };
 
-        int w = 0;
-        for (int i = 0; i < BOARD_W + 2 && w + 1 < UPDATE_TEXT_MAX; i++) {
-            out[n].text[w++] = render_next[r][i];
-            if (render_next[r][i] == '\0') break;
-        }
-        out[n].text[UPDATE_TEXT_MAX - 1] = '\0';
+struct editor_cursor {
+    int8_t line;    /* -1: unknown */
+    int8_t col;     /* -1: unknown */
+    int8_t want;
+};
 
-        /* optimistic commit */
-        for (int i = 0; i < BOARD_W + 2; i++) {
-            render_prev[r][i] = render_next[r][i];
-            if (render_next[r][i] == '\0') break;
-        }
+static struct editor_cursor ed_cur = { -1, -1, -1 };
 
-        n++;
-    }
-    return n;
+static void cursor_set(int line, int col) {
+    ed_cur.line = (int8_t)line;
+    ed_cur.col = (int8_t)col;
+    ed_cur.want = (int8_t)col;
+}
+
+static void cursor_invalidate(void) {
+    cursor_set(-1, -1);
 }
 
 /* ==============================
- * Render engine (async)
+ * Render plan bytecode
+ *
+ * A frame is compiled into a compact op stream that render_work_handler
+ * interprets one key per tick. Counted ops repeat their key n times;
+ * OP_TYPE carries its characters inline. Game lines (score, board rows) are
+ * not copied into the plan: OP_TYPE_LINE and OP_TYPE_FRAME name the line and
+ * its text is built from the frame snapshot when typing reaches it. Between
+ * OP_ADD_CURSOR_DOWN and OP_SINGLE_CURSOR every key goes to a column of
+ * cursors on consecutive lines, and OP_TYPE_LINE types into all of them.
+ * OP_INSERT_LINE and OP_DELETE_SPAN patch a line in place, shifting the
+ * rest of it.
+ *
+ *   op [n] [chars...]
+ *   OP_TYPE_LINE / OP_INSERT_LINE / OP_DELETE_SPAN src from n
+ *   OP_MOVE_LINE_UP src n
  * ============================== */
-enum render_mode { RENDER_IDLE = 0, RENDER_CLEAR_EDITOR, RENDER_TYPE_FULL, RENDER_REPLACE_LINE_SCRIPT };
-enum clear_phase { CLP_CTRL_A = 0, CLP_BS, CLP_DONE };
-enum script_phase {
-    SPH_CTRL_HOME = 0, SPH_DOWN_REPEAT, SPH_HOME, SPH_SHIFT_END_PRESS, SPH_END_TAP,
-    SPH_SHIFT_END_RELEASE, SPH_BACKSPACE, SPH_TYPE_LINE, SPH_DONE
+#define RENDER_PLAN_MAX 384
+#define SHIFT_SETTLE_MS 4
+#define PATCH_SHIFT_MAX 3    /* widest shift (cells) a row patch looks for */
+
+#define LINE_SRC_SCORE 0xff  /* OP_TYPE_LINE source; board rows are 0..BOARD_H-1 */
+#define FRAME_TITLE "tetris zmk"
+
+enum plan_op {
+    OP_DOC_START = 0,   /* Ctrl+Home */
+    OP_DOC_END,         /* Ctrl+End */
+    OP_UP,              /* n */
+    OP_DOWN,            /* n */
+    OP_LEFT,            /* n */
+    OP_RIGHT,           /* n */
+    OP_WORD_LEFT,       /* n, Ctrl+Left */
+    OP_WORD_RIGHT,      /* n, Ctrl+Right */
+    OP_HOME,
+    OP_LINE_END,        /* End */
+    OP_SHIFT_PRESS,
+    OP_SHIFT_RELEASE,
+    OP_DELETE_LINE,     /* Ctrl+Shift+K */
+    OP_SELECT_ALL,      /* Ctrl+A */
+    OP_BACKSPACE,       /* n */
+    OP_TYPE,            /* n, chars */
+    OP_TYPE_LINE,       /* src, from, n: span of a late-bound line */
+    OP_INSERT_LINE,     /* src, from, n: as OP_TYPE_LINE, inserted */
+    OP_DELETE_SPAN,     /* src, from, n: Delete n times at column from */
+    OP_TYPE_FRAME,      /* whole editor, lines bound as typed */
+    OP_DUPLICATE_LINE,  /* Shift+Alt+Down, the cursor moves onto the copy */
+    OP_ADD_CURSOR_DOWN, /* n, Ctrl+Alt+Down */
+    OP_SINGLE_CURSOR,   /* Escape, back to the topmost cursor */
+    OP_MOVE_LINE_UP,    /* src, n: Alt+Up n times, board row src rises n lines */
+    OP_UNDO,            /* n, Ctrl+Z */
+    OP_REDO,            /* n, Ctrl+Y */
+    OP_LOCK_TOGGLE,     /* Scroll Lock, host acknowledges via LED */
 };
-enum request_type { REQ_NONE = 0, REQ_CLEAR_ONLY, REQ_RESET_AND_DRAW };
 
-struct render_state {
-    bool inited;
-    bool running;
+/* full frame line lengths, without the newline */
+static uint8_t frame_line_len(int line) {
+    if (line == 0) return sizeof(FRAME_TITLE) - 1;
+    if (line == 1) return SCORE_LINE_LEN;
+    if (line < BOARD_TOP_LINE_INDEX) return 0;
+    return BOARD_W + 1;
+}
 
-    enum request_type req;
-    enum render_mode mode;
+/* OP_TYPE_FRAME progress */
+struct frame_pos {
+    uint8_t line;
+    uint8_t col;        /* chars of the line typed */
+    uint8_t dups;       /* rows below it still to make by duplicating it */
+};
 
-    enum clear_phase clear_phase;
+enum frame_key { FRAME_KEY_DONE = 0, FRAME_KEY_CHAR, FRAME_KEY_DUP };
 
-    const char *text;
-    size_t text_idx;
+static inline bool op_counted(uint8_t op) {
+    return (op >= OP_UP && op <= OP_WORD_RIGHT) || op == OP_BACKSPACE || op == OP_TYPE ||
+           op == OP_ADD_CURSOR_DOWN || op == OP_UNDO || op == OP_REDO;
+}
 
-    enum script_phase phase;
-    int down_remaining;
-    const char *line_text;
-    size_t line_idx;
+/* ops editing a span of a game line, committed to the model when done */
+static inline bool op_line_span(uint8_t op) {
+    return op == OP_TYPE_LINE || op == OP_INSERT_LINE || op == OP_DELETE_SPAN;
+}
 
-    struct update_line batch[MAX_UPDATE_LINES];
-    uint8_t batch_len;
-    uint8_t batch_pos;
+static uint16_t op_size(const uint8_t *buf, uint16_t pc) {
+    if (buf[pc] == OP_TYPE) return (uint16_t)(2 + buf[pc + 1]);
+    if (op_line_span(buf[pc])) return 4;
+    if (buf[pc] == OP_MOVE_LINE_UP) return 3;
+    return op_counted(buf[pc]) ? 2 : 1;
+}
 
-    struct k_work_delayable work;
+/* ops adding, removing or joining editor lines */
+static bool op_changes_layout(const uint8_t *buf, uint16_t pc) {
+    switch (buf[pc]) {
+    case OP_DELETE_LINE:
+    case OP_SELECT_ALL:
+    case OP_BACKSPACE:
+    case OP_TYPE_FRAME:
+    case OP_DUPLICATE_LINE:
+        return true;
+    case OP_TYPE:
+        for (uint8_t i = 0; i < buf[pc + 1]; i++) {
+            if (buf[pc + 2 + i] == '\n') return true;
+        }
+        return false;
+    default:
+        return false;
+    }
+}
+
+/* key presses per repetition; chords count every key */
+static uint8_t op_keys(uint8_t op) {
+    switch (op) {
+    case OP_DOC_START:
+    case OP_DOC_END:
+    case OP_WORD_LEFT:
+    case OP_WORD_RIGHT:
+    case OP_SELECT_ALL:
+    case OP_MOVE_LINE_UP:
+    case OP_UNDO:
+    case OP_REDO:
+        return 2;
+    case OP_DELETE_LINE:
+    case OP_DUPLICATE_LINE:
+    case OP_ADD_CURSOR_DOWN:
+        return 3;
+    case OP_SHIFT_RELEASE:
+        return 0;
+    default:
+        return 1;
+    }
+}
+
+/* pause after one repetition of `op` (c: typed char) */
+static uint32_t op_delay(uint8_t op, char c, bool shift_held) {
+    switch (op) {
+    case OP_TYPE:
+    case OP_TYPE_LINE:
+    case OP_INSERT_LINE:
+    case OP_TYPE_FRAME:
+        return delay_for_char(c);
+    case OP_SHIFT_PRESS:
+        return SHIFT_SETTLE_MS;
+    case OP_SHIFT_RELEASE:
+    case OP_DELETE_LINE:
+    case OP_DUPLICATE_LINE:
+    case OP_ADD_CURSOR_DOWN:
+    case OP_SINGLE_CURSOR:
+    case OP_MOVE_LINE_UP:
+    case OP_UNDO:
+    case OP_REDO:
+    case OP_SELECT_ALL:
+    case OP_BACKSPACE:
+    case OP_DELETE_SPAN:
+        return delay_action();
+    default:
+        /* navigation; extending a selection only waits for shift to settle */
+        return shift_held ? SHIFT_SETTLE_MS : delay_nav();
+    }
+}
+
+/* ==============================
+ * Renderer: cost model
+ *
+ * Plans are compared by their delay budget (the time the typing takes),
+ * then by key presses. Emitting into a plan without a buffer only costs it.
+ * ============================== */
+struct render_cost {
+    uint16_t keys;
+    uint32_t ms;
 };
 
-static struct render_state rs;
+static inline bool cost_less(const struct render_cost *a, const struct render_cost *b) {
+    return (a->ms != b->ms) ? (a->ms < b->ms) : (a->keys < b->keys);
+}
 
-static struct k_work_delayable gravity_work;
-static struct k_work_delayable clear_work;
-static struct k_work_delayable spawn_work;
+struct render_plan {
+    uint8_t *buf;       /* NULL: cost only */
+    uint16_t cap;
+    uint16_t len;
+    bool overflow;
+    bool shift_held;
+    struct render_cost cost;
+};
 
-/* forward */
-static void apply_pending_and_redraw_once(void);
+static void plan_put(struct render_plan *p, uint8_t b) {
+    if (p->buf) {
+        if (p->len < p->cap) p->buf[p->len] = b;
+        else p->overflow = true;
+    }
+    p->len++;
+}
 
-static void stop_render(void) {
-    rs.running = false;
-    rs.req = REQ_NONE;
-    rs.mode = RENDER_IDLE;
-    rs.batch_len = 0;
-    rs.batch_pos = 0;
-    k_work_cancel_delayable(&rs.work);
+static void plan_charge(struct render_plan *p, uint8_t op, char c) {
+    p->cost.keys = (uint16_t)(p->cost.keys + op_keys(op));
+    p->cost.ms += op_delay(op, c, p->shift_held);
 }
 
-static void start_clear_editor_async(enum request_type req_after) {
-    rs.req = req_after;
-    rs.mode = RENDER_CLEAR_EDITOR;
-    rs.clear_phase = CLP_CTRL_A;
-    rs.running = true;
-    k_work_reschedule(&rs.work, K_NO_WAIT);
+static void plan_op(struct render_plan *p, uint8_t op) {
+    plan_put(p, op);
+    plan_charge(p, op, 0);
+    if (op == OP_SHIFT_PRESS) p->shift_held = true;
+    else if (op == OP_SHIFT_RELEASE) p->shift_held = false;
 }
 
-static void start_full_text_async(const char *text) {
-    rs.mode = RENDER_TYPE_FULL;
-    rs.text = text;
-    rs.text_idx = 0;
-    rs.running = true;
-    k_work_reschedule(&rs.work, K_NO_WAIT);
+static void plan_op_n(struct render_plan *p, uint8_t op, int n) {
+    while (n > 0) {
+        uint8_t chunk = (uint8_t)MIN(n, 255);
+        plan_put(p, op);
+        plan_put(p, chunk);
+        for (uint8_t i = 0; i < chunk; i++) plan_charge(p, op, 0);
+        n -= chunk;
+    }
 }
 
-static void start_replace_line_script(int line_index_zero_based, const char *line) {
-    rs.mode = RENDER_REPLACE_LINE_SCRIPT;
-    rs.phase = SPH_CTRL_HOME;
-    rs.down_remaining = line_index_zero_based;
-    rs.line_text = line;
-    rs.line_idx = 0;
+static void plan_type(struct render_plan *p, const char *text, int n) {
+    while (n > 0) {
+        uint8_t chunk = (uint8_t)MIN(n, 255);
+        plan_put(p, OP_TYPE);
+        plan_put(p, chunk);
+        for (uint8_t i = 0; i < chunk; i++) {
+            plan_put(p, (uint8_t)text[i]);
+            plan_charge(p, OP_TYPE, text[i]);
+        }
+        text += chunk;
+        n -= chunk;
+    }
+}
 
-    rs.running = true;
-    k_work_reschedule(&rs.work, K_NO_WAIT);
+/* n chars of line `src` from column `from` (op: OP_TYPE_LINE and friends) */
+static void plan_line_span(struct render_plan *p, uint8_t op, uint8_t src, int from, int n) {
+    if (n <= 0) return;
+    plan_put(p, op);
+    plan_put(p, src);
+    plan_put(p, (uint8_t)from);
+    plan_put(p, (uint8_t)n);
+    for (int i = 0; i < n; i++) plan_charge(p, op, 'x');
 }
 
-static void start_batch(struct update_line *lines, uint8_t len) {
-    if (len == 0) return;
-    if (len > MAX_UPDATE_LINES) len = MAX_UPDATE_LINES;
+/* move board row `src` up past the n lines above it */
+static void plan_move_line_up(struct render_plan *p, uint8_t src, int n) {
+    plan_put(p, OP_MOVE_LINE_UP);
+    plan_put(p, src);
+    plan_put(p, (uint8_t)n);
+    for (int i = 0; i < n; i++) plan_charge(p, OP_MOVE_LINE_UP, 0);
+}
 
-    for (uint8_t i = 0; i < len; i++) rs.batch[i] = lines[i];
-    rs.batch_len = len;
-    rs.batch_pos = 0;
+/* n chars of line `src` from column `from`, bound when typed */
+static void plan_type_line(struct render_plan *p, uint8_t src, int from, int n) {
+    plan_line_span(p, OP_TYPE_LINE, src, from, n);
+}
 
-    start_replace_line_script(rs.batch[0].line_index, rs.batch[0].text);
+static void plan_motion_ops(struct render_plan *p, const struct motion *m) {
+    if (m->anchor == MOT_FROM_HOME) plan_op(p, OP_HOME);
+    else if (m->anchor == MOT_FROM_END) plan_op(p, OP_LINE_END);
+    plan_op_n(p, m->jump_dir > 0 ? OP_WORD_RIGHT : OP_WORD_LEFT, m->jumps);
+    plan_op_n(p, m->fine > 0 ? OP_RIGHT : OP_LEFT, m->fine < 0 ? -m->fine : m->fine);
 }
 
-/* full frame buffer */
-static char full_frame_buf[512];
+/* ==============================
+ * Render plan peephole optimizer
+ *
+ * Plans are generated line by line; this pass cleans up the seams:
+ * merges runs of cursor moves, drops selections that select nothing and
+ * fuses adjacent typing into one op.
+ * ============================== */
+static inline bool op_vertical(uint8_t op) { return op == OP_UP || op == OP_DOWN; }
+
+static bool plan_peephole(uint8_t *buf, uint16_t *len) {
+    bool changed = false;
+    uint16_t w = 0;
+    int last = -1;  /* start of the last op written */
+
+    for (uint16_t i = 0; i < *len;) {
+        uint16_t sz = op_size(buf, i);
+        uint8_t op = buf[i];
+
+        if (last >= 0) {
+            uint8_t lop = buf[last];
+
+            /* Up/Down runs collapse to their net move (never past the document edges) */
+            if (op_vertical(op) && op_vertical(lop)) {
+                int v = (lop == OP_DOWN ? buf[last + 1] : -buf[last + 1]) +
+                        (op == OP_DOWN ? buf[i + 1] : -buf[i + 1]);
+                if (v >= -255 && v <= 255) {
+                    if (v == 0) {
+                        w = (uint16_t)last;
+                        last = -1;
+                    } else {
+                        buf[last] = v > 0 ? OP_DOWN : OP_UP;
+                        buf[last + 1] = (uint8_t)(v > 0 ? v : -v);
+                    }
+                    i += sz;
+                    changed = true;
+                    continue;
+                }
+            }
 
-static void build_full_frame_text(void) {
-    size_t w = 0;
+            /* same-direction repeats */
+            if (op == lop && op_counted(op) && op != OP_TYPE && buf[last + 1] + buf[i + 1] <= 255) {
+                buf[last + 1] = (uint8_t)(buf[last + 1] + buf[i + 1]);
+                i += sz;
+                changed = true;
+                continue;
+            }
 
-    const char *hdr = "tetris zmk\n";
-    for (size_t i = 0; hdr[i] && w + 1 < sizeof(full_frame_buf); i++) full_frame_buf[w++] = hdr[i];
+            /* Home after Ctrl+Home / Home, End after End */
+            if ((op == OP_HOME && (lop == OP_HOME || lop == OP_DOC_START)) ||
+                (op == OP_LINE_END && lop == OP_LINE_END)) {
+                i += sz;
+                changed = true;
+                continue;
+            }
 
-    build_score_next();
-    for (size_t i = 0; score_next[i] && w + 1 < sizeof(full_frame_buf); i++) full_frame_buf[w++] = score_next[i];
-    if (w + 1 < sizeof(full_frame_buf)) full_frame_buf[w++] = '\n';
-    if (w + 1 < sizeof(full_frame_buf)) full_frame_buf[w++] = '\n';
+            /* empty selection, or a release immediately re-pressed */
+            if ((op == OP_SHIFT_RELEASE && lop == OP_SHIFT_PRESS) ||
+                (op == OP_SHIFT_PRESS && lop == OP_SHIFT_RELEASE)) {
+                w = (uint16_t)last;
+                last = -1;
+                i += sz;
+                changed = true;
+                continue;
+            }
 
-    rebuild_render_next();
-    for (int r = 0; r < BOARD_H; r++) {
-        for (int i = 0; render_next[r][i] && w + 1 < sizeof(full_frame_buf); i++) full_frame_buf[w++] = render_next[r][i];
-        if (w + 1 < sizeof(full_frame_buf)) full_frame_buf[w++] = '\n';
+            /* adjacent typing */
+            if (op == OP_TYPE && lop == OP_TYPE && buf[last + 1] + buf[i + 1] <= 255) {
+                uint8_t n = buf[i + 1];
+                for (uint8_t k = 0; k < n; k++) buf[w + k] = buf[i + 2 + k];
+                buf[last + 1] = (uint8_t)(buf[last + 1] + n);
+                w = (uint16_t)(w + n);
+                i += sz;
+                changed = true;
+                continue;
+            }
+        }
+
+        for (uint16_t k = 0; k < sz; k++) buf[w + k] = buf[i + k];
+        last = w;
+        w = (uint16_t)(w + sz);
+        i += sz;
     }
 
-    full_frame_buf[w] = '\0';
+    *len = w;
+    return changed;
 }
 
+static void plan_optimize(uint8_t *buf, uint16_t *len) {
+    while (plan_peephole(buf, len)) {
+    }
+}
 
-/* build a combined diff batch: score line + board lines */
-static void request_diff_render(void) {
-    if (rs.running) return;
+/* ==============================
+ * Renderer: diff lines
+ * ============================== */
+enum line_op {
+    LINE_OP_REPLACE = 0,    /* select (part of) the line and type over it */
+    LINE_OP_DELETE,         /* Ctrl+Shift+K */
+    LINE_OP_INSERT,         /* type text + newline at the line start */
+    LINE_OP_PATCH,          /* delete n chars at `del`, insert n at `from` */
+    LINE_OP_MOVE_UP,        /* Alt+Up n times */
+};
+
+struct update_line {
+    uint8_t op;             /* enum line_op */
+    uint8_t nav;            /* enum nav_anchor: Ctrl+Home / Ctrl+End / none */
+    int8_t vert;            /* Up (<0) / Down (>0) taps after the anchor */
+    struct motion seek;     /* -> first column to replace (patch: `del`) */
+    struct motion select;   /* shift-select to the end of the replaced span
+                             * (patch: `del` -> `from` once deleted) */
+    uint8_t cursors;        /* LINE_OP_REPLACE: lines edited at once, from this one down */
+    const char *text;       /* LINE_OP_INSERT: typed before the newline */
+    uint8_t src;            /* LINE_OP_REPLACE: LINE_SRC_SCORE or board row */
+    uint8_t from, n;        /* span of it to type */
+    uint8_t del;            /* LINE_OP_PATCH */
+};
 
-    struct update_line lines[MAX_UPDATE_LINES];
-    uint8_t len = 0;
+/* plan generator for one line edit */
+static void plan_line(struct render_plan *p, const struct update_line *u) {
+    if (u->nav == NAV_DOC_START) plan_op(p, OP_DOC_START);
+    else if (u->nav == NAV_DOC_END) plan_op(p, OP_DOC_END);
+    plan_op_n(p, u->vert > 0 ? OP_DOWN : OP_UP, u->vert < 0 ? -u->vert : u->vert);
 
-    /* score line (line 1) */
-    build_score_next();
-    if (!score_equals() && len < MAX_UPDATE_LINES) {
-        lines[len].line_index = 1;
-        for (int i = 0; i < UPDATE_TEXT_MAX; i++) {
-            lines[len].text[i] = score_next[i];
-            if (score_next[i] == '\0') break;
-        }
-        lines[len].text[UPDATE_TEXT_MAX - 1] = '\0';
-        commit_score_line();
-        len++;
+    if (u->op == LINE_OP_DELETE) {
+        plan_op(p, OP_DELETE_LINE);
+        return;
+    }
+    if (u->op == LINE_OP_MOVE_UP) {
+        plan_move_line_up(p, u->src, u->n);
+        return;
     }
 
-    /* board diff */
-    rebuild_render_next();
-    struct update_line board_lines[MAX_UPDATE_LINES];
-    uint8_t b_len = make_board_diff(board_lines);
+    plan_motion_ops(p, &u->seek);
+    if (u->op == LINE_OP_PATCH) {
+        plan_line_span(p, OP_DELETE_SPAN, u->src, u->del, u->n);
+        plan_motion_ops(p, &u->select);
+        plan_line_span(p, OP_INSERT_LINE, u->src, u->from, u->n);
+        return;
+    }
+    if (u->op == LINE_OP_REPLACE) {
+        plan_op_n(p, OP_ADD_CURSOR_DOWN, u->cursors - 1);
 
-    for (uint8_t i = 0; i < b_len && len < MAX_UPDATE_LINES; i++) {
-        lines[len++] = board_lines[i];
+        /* typing over the selection replaces it */
+        plan_op(p, OP_SHIFT_PRESS);
+        plan_motion_ops(p, &u->select);
+        plan_op(p, OP_SHIFT_RELEASE);
     }
 
-    if (len == 0) return;
-    start_batch(lines, len);
+    if (u->op == LINE_OP_INSERT) {
+        int n = 0;
+        while (u->text[n]) n++;
+        plan_type(p, u->text, n);
+        plan_type(p, "\n", 1);
+    } else {
+        plan_type_line(p, u->src, u->from, u->n);
+        if (u->cursors > 1) plan_op(p, OP_SINGLE_CURSOR);
+    }
 }
 
+static struct render_cost line_cost(const struct update_line *u) {
+    struct render_plan probe = { 0 };
+    plan_line(&probe, u);
+    return probe.cost;
+}
 
-static void force_redraw_all(void) {
-    /* render_prevを全消しして差分を“全行”にする */
-    for (int r = 0; r < BOARD_H; r++) {
-        for (int i = 0; i < BOARD_W + 2; i++) render_prev[r][i] = '\0';
+/* cheapest Ctrl+Home/Ctrl+End/relative way onto `line_index` */
+static void plan_vertical(struct update_line *u, int line_index) {
+    u->nav = NAV_DOC_START;
+    u->vert = (int8_t)line_index;
+
+    int best = 1 + line_index;
+    int from_end = LAST_LINE_INDEX - line_index;
+    if (1 + from_end < best) {
+        best = 1 + from_end;
+        u->nav = NAV_DOC_END;
+        u->vert = (int8_t)-from_end;
+    }
+    if (ed_cur.line >= 0) {
+        int d = line_index - ed_cur.line;
+        if ((d < 0 ? -d : d) <= best) {
+            u->nav = NAV_RELATIVE;
+            u->vert = (int8_t)d;
+        }
     }
-    score_prev[0] = '\0'; /* scoreも必ず更新させる */
-
-    request_diff_render();
 }
 
-static void render_work_handler(struct k_work *work) {
-    ARG_UNUSED(work);
-    if (!rs.running) return;
+/* Ctrl+Shift+K on `line_index`; the line below moves up under the cursor */
+static void make_line_delete(struct render_plan *p, int line_index) {
+    struct update_line u;
 
-    if (rs.mode == RENDER_CLEAR_EDITOR) {
-        switch (rs.clear_phase) {
-        case CLP_CTRL_A:
-            tap_with_mod(LCTRL, A);
-            rs.clear_phase = CLP_BS;
-            k_work_reschedule(&rs.work, K_MSEC(delay_action()));
-            return;
-        case CLP_BS:
-            tap(BACKSPACE);
-            rs.clear_phase = CLP_DONE;
-            k_work_reschedule(&rs.work, K_MSEC(delay_action()));
-            return;
-        case CLP_DONE:
-        default: {
-            enum request_type next = rs.req;
-            rs.req = REQ_NONE;
-
-            if (next == REQ_RESET_AND_DRAW) {
-                start_full_text_async(full_frame_buf);
-                return;
-            }
+    u.op = LINE_OP_DELETE;
+    plan_vertical(&u, line_index);
+    plan_line(p, &u);
 
-            rs.running = false;
-            rs.mode = RENDER_IDLE;
-            rs.batch_len = 0;
-            rs.batch_pos = 0;
+    cursor_set(line_index, -1);
+}
 
-            apply_pending_and_redraw_once();
-            return;
-        }
-        }
-    }
+/* type `text` + newline at the start of `line_index`, pushing it down */
+static void make_line_insert(struct render_plan *p, int line_index, const char *text) {
+    struct update_line u;
 
-    if (rs.mode == RENDER_TYPE_FULL) {
-        char c = rs.text[rs.text_idx];
-        if (c == '\0') {
-            rebuild_render_next();
-            for (int r = 0; r < BOARD_H; r++) {
-                for (int i = 0; i < BOARD_W + 2; i++) {
-                    render_prev[r][i] = render_next[r][i];
-                    if (render_next[r][i] == '\0') break;
-                }
-            }
+    u.op = LINE_OP_INSERT;
+    plan_vertical(&u, line_index);
 
-            /* score commit as well */
-            build_score_next();
-            commit_score_line();
+    int col = (u.nav != NAV_RELATIVE) ? 0 : (ed_cur.line == line_index ? ed_cur.col : -1);
+    plan_motion("", 0, col, 0, &u.seek);
 
-            rs.running = false;
-            rs.mode = RENDER_IDLE;
-            rs.batch_len = 0;
-            rs.batch_pos = 0;
+    u.text = text;
+    plan_line(p, &u);
 
-            apply_pending_and_redraw_once();
-            return;
-        }
+    cursor_set(line_index + 1, 0);
+}
 
-        uint32_t kc;
-        if (char_to_keycode(c, &kc)) tap(kc);
-        rs.text_idx++;
-        k_work_reschedule(&rs.work, K_MSEC(delay_for_char(c)));
-        return;
-    }
+static char render_prev[BOARD_H][BOARD_W + 2];
+static char render_next[BOARD_H][BOARD_W + 2];
 
-    if (rs.mode == RENDER_REPLACE_LINE_SCRIPT) {
-        switch (rs.phase) {
-        case SPH_CTRL_HOME:
-            tap_with_mod(LCTRL, HOME);
-            rs.phase = SPH_DOWN_REPEAT;
-            k_work_reschedule(&rs.work, K_MSEC(delay_nav()));
-            return;
+/* model (what the editor shows) and freshly built text of a game line */
+static char *line_prev(uint8_t src) {
+    return (src == LINE_SRC_SCORE) ? score_prev : render_prev[src];
+}
+static char *line_next(uint8_t src) {
+    return (src == LINE_SRC_SCORE) ? score_next : render_next[src];
+}
 
-        case SPH_DOWN_REPEAT:
-            if (rs.down_remaining > 0) {
-                tap(DOWN);
-                rs.down_remaining--;
-                k_work_reschedule(&rs.work, K_MSEC(delay_nav()));
-                return;
-            }
-            rs.phase = SPH_HOME;
-            k_work_reschedule(&rs.work, K_MSEC(delay_nav()));
-            return;
+/* Plan the cheapest edit turning line_prev(src) (what the editor shows)
+ * into line_next(src), navigating from the tracked cursor, and advance the
+ * cursor past the edit. An empty prev means the editor content is unknown:
+ * the line can only be replaced as a whole. */
+static void make_line_update(struct render_plan *p, int line_index, uint8_t src) {
+    const char *prev = line_prev(src);
+    const char *next = line_next(src);
+
+    int len = 0;
+    while (next[len] && len + 1 < UPDATE_TEXT_MAX) len++;
+
+    int prev_len = 0;
+    while (prev[prev_len] && prev_len < UPDATE_TEXT_MAX) prev_len++;
+
+    /* ways onto the line; col is where the cursor lands (-1: unknown) */
+    struct { uint8_t nav; int8_t vert; int col; } opt[3] = {
+        { NAV_DOC_START, (int8_t)line_index, 0 },
+        { NAV_DOC_END, (int8_t)(line_index - LAST_LINE_INDEX), 0 },
+    };
+    int n_opt = 2;
+    if (ed_cur.line >= 0) {
+        int col = ed_cur.col;
+        if (ed_cur.line != line_index) col = (prev_len > 0) ? MIN(ed_cur.want, prev_len) : -1;
+        opt[n_opt].nav = NAV_RELATIVE;
+        opt[n_opt].vert = (int8_t)(line_index - ed_cur.line);
+        opt[n_opt++].col = col;
+    }
 
-        case SPH_HOME:
-            tap(HOME);
-            rs.phase = SPH_SHIFT_END_PRESS;
-            k_work_reschedule(&rs.work, K_MSEC(delay_action()));
-            return;
+    /* changed span, if the old content is known */
+    int a = 0, b = len;
+    bool span = false;
+    if (prev_len == len && len > 0) {
+        while (a < len && prev[a] == next[a]) a++;
+        while (b > a && prev[b - 1] == next[b - 1]) b--;
+        span = (a < b);
+    }
 
-        case SPH_SHIFT_END_PRESS:
-            press(LSHIFT);
-            rs.phase = SPH_END_TAP;
-            k_work_reschedule(&rs.work, K_MSEC(4));
-            return;
+    struct update_line cand, best_line;
+    struct render_cost best = { 0, 0 };
+    int end_col = len;
+    bool have = false;
+
+    cand.op = LINE_OP_REPLACE;
+    cand.cursors = 1;
+    cand.src = src;
+    for (int i = 0; i < n_opt; i++) {
+        cand.nav = opt[i].nav;
+        cand.vert = opt[i].vert;
+
+        /* line diff: Home, Shift+End, retype */
+        plan_motion(prev, prev_len, opt[i].col, 0, &cand.seek);
+        cand.select = (struct motion){ MOT_FROM_END, 0, 1, 0 };
+        cand.from = 0;
+        cand.n = (uint8_t)len;
+        struct render_cost c = line_cost(&cand);
+        if (!have || cost_less(&c, &best)) {
+            best_line = cand;
+            best = c;
+            end_col = len;
+            have = true;
+        }
 
-        case SPH_END_TAP:
-            tap(END);
-            rs.phase = SPH_SHIFT_END_RELEASE;
-            k_work_reschedule(&rs.work, K_MSEC(4));
-            return;
+        if (!span) continue;
+
+        /* span diff: first changed column, select to the last, retype */
+        plan_motion(prev, len, opt[i].col, a, &cand.seek);
+        plan_motion(prev, len, a, b, &cand.select);
+        cand.from = (uint8_t)a;
+        cand.n = (uint8_t)(b - a);
+        c = line_cost(&cand);
+        if (cost_less(&c, &best)) {
+            best_line = cand;
+            best = c;
+            end_col = b;
+        }
 
-        case SPH_SHIFT_END_RELEASE:
-            release(LSHIFT);
-            rs.phase = SPH_BACKSPACE;
-            k_work_reschedule(&rs.work, K_MSEC(delay_action()));
+        /* patch: the span's text moved by d columns, so delete d chars on
+         * one side of it and type d on the other */
+        for (int d = 1; d < b - a && d <= PATCH_SHIFT_MAX; d++) {
+            for (int dir = 0; dir < 2; dir++) {
+                /* dir 0: moved left, cut at a and type at b-d; 1: the reverse */
+                const char *was = dir ? prev + a : prev + a + d;
+                const char *now = dir ? next + a + d : next + a;
+                int k = 0;
+                while (k < b - a - d && was[k] == now[k]) k++;
+                if (k < b - a - d) continue;
+
+                struct update_line patch = cand;
+                patch.op = LINE_OP_PATCH;
+                patch.del = (uint8_t)(dir ? b - d : a);
+                patch.from = (uint8_t)(dir ? a : b - d);
+                patch.n = (uint8_t)d;
+
+                /* the line while the d chars are cut out */
+                char cut[UPDATE_TEXT_MAX];
+                int m = 0;
+                for (int j = 0; j < len; j++) {
+                    if (j < patch.del || j >= patch.del + d) cut[m++] = prev[j];
+                }
+                plan_motion(prev, len, opt[i].col, patch.del, &patch.seek);
+                plan_motion(cut, m, patch.del, patch.from, &patch.select);
+                c = line_cost(&patch);
+                if (cost_less(&c, &best)) {
+                    best_line = patch;
+                    best = c;
+                    end_col = patch.from + d;
+                }
+            }
+        }
+    }
+
+    plan_line(p, &best_line);
+    cursor_set(line_index, end_col);
+}
+
+/* ==============================
+ * Frame snapshot
+ *
+ * The game keeps running while a frame is typed. What the frame shows is
+ * captured when it is planned, and its lines are built from that capture
+ * as typing reaches them, so one frame never mixes two game steps.
+ * ============================== */
+static struct {
+    uint16_t cells[BOARD_H];    /* locked cells and the falling piece */
+    uint16_t blink;             /* cleared rows, drawn as the blink */
+    bool blink_on;              /* '=' phase */
+} frame;
+
+/* score_next is part of the snapshot */
+static void frame_capture(void) {
+    build_score_next();
+
+    for (int r = 0; r < BOARD_H; r++) {
+        frame.cells[r] = board_rows[r];
+        /* do NOT show next piece while clearing */
+        if (has_falling && !clearing) {
+            frame.cells[r] |= piece_row_cells(SHAPE[falling.type][falling.rot & 3], falling.x, falling.y, r);
+        }
+    }
+    frame.blink = clearing ? clear_mask : 0;
+    frame.blink_on = ((clear_step % 2) == 0);
+}
+
+static void build_row_string(int row, char out[BOARD_W + 2]) {
+    /* clear effect overrides */
+    if (frame.blink & (1u << row)) {
+        for (int c = 0; c < BOARD_W; c++) out[c] = frame.blink_on ? '=' : '.';
+        out[BOARD_W] = ' ';
+        out[BOARD_W + 1] = '\0';
+        return;
+    }
+
+    uint16_t cells = frame.cells[row];
+    for (int c = 0; c < BOARD_W; c++) out[c] = (cells & (1u << c)) ? 'x' : '.';
+
+    out[BOARD_W] = ' ';
+    out[BOARD_W + 1] = '\0';
+}
+
+static void rebuild_render_rows(uint16_t rows) {
+    for (int r = 0; r < BOARD_H; r++) {
+        if (rows & (1u << r)) build_row_string(r, render_next[r]);
+    }
+}
+
+static bool row_equals(const char *a, const char *b) {
+    for (int i = 0; i < BOARD_W + 2; i++) {
+        if (a[i] != b[i]) return false;
+        if (a[i] == '\0') break;
+    }
+    return true;
+}
+
+/* changed columns [*a, *b) of a known board row; false if it is unknown
+ * or cut short by a patch */
+static bool row_span(int r, int *a, int *b) {
+    const char *prev = render_prev[r];
+    const char *next = render_next[r];
+
+    for (int i = 0; i <= BOARD_W; i++) {
+        if (prev[i] == '\0') return false;
+    }
+    *a = 0;
+    *b = BOARD_W + 1;
+    while (*a < *b && prev[*a] == next[*a]) (*a)++;
+    while (*b > *a && prev[*b - 1] == next[*b - 1]) (*b)--;
+    return true;
+}
+
+/* Changed rows from `r` down taking one shared edit: their changed columns
+ * fall in [*a, *b) and the new text there is the same. Returns how many. */
+static int column_run(uint16_t rows, int r, int *a, int *b) {
+    if (!row_span(r, a, b)) return 1;
+
+    int k = 1;
+    for (int n = r + 1; n < BOARD_H; n++, k++) {
+        int na, nb;
+        if (!(rows & (1u << n)) || !row_span(n, &na, &nb) || na >= nb) break;
+
+        na = MIN(na, *a);
+        nb = MAX(nb, *b);
+        bool same = true;
+        for (int i = na; i < nb && same; i++) {
+            for (int m = r; m <= n && same; m++) same = (render_next[m][i] == render_next[r][i]);
+        }
+        if (!same) break;
+        *a = na;
+        *b = nb;
+    }
+    return k;
+}
+
+/* Rows r..*bot that the editor shows one line higher than the next frame,
+ * apart from the bottom one, which belongs on top: a piece falling through
+ * otherwise empty rows. Moving that bottom line up over the others draws
+ * the frame. */
+static bool move_window(uint16_t rows, int r, int *bot) {
+    for (int n = r + 1; n < BOARD_H && (rows & (1u << n)); n++) {
+        if (!row_equals(render_next[n], render_prev[n - 1])) return false;
+        if (row_equals(render_next[r], render_prev[n])) {
+            *bot = n;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Alt+Up on row `bot` until it is row `top`; the column is left unknown */
+static void make_line_move(struct render_plan *p, int top, int bot) {
+    struct update_line u;
+
+    u.op = LINE_OP_MOVE_UP;
+    u.src = (uint8_t)bot;
+    u.n = (uint8_t)(bot - top);
+    plan_vertical(&u, BOARD_TOP_LINE_INDEX + bot);
+    plan_line(p, &u);
+
+    cursor_set(BOARD_TOP_LINE_INDEX + top, -1);
+}
+
+/* cost of the line-by-line edits of the changed rows among r..r+k-1 */
+static struct render_cost lines_cost(int r, int k) {
+    struct editor_cursor cur = ed_cur;
+    struct render_plan lines = { 0 };
+
+    for (int n = r; n < r + k; n++) {
+        if (!row_equals(render_prev[n], render_next[n])) make_line_update(&lines, BOARD_TOP_LINE_INDEX + n, (uint8_t)n);
+    }
+    ed_cur = cur;
+    return lines.cost;
+}
+
+/* Edit rows r..r+k-1 at once: seek to column a on the first, add a cursor
+ * on each row below (Ctrl+Alt+Down keeps the column, the rows are equally
+ * long), select to b and type the span once. Only Right and End select the
+ * same span on every line. */
+static void make_column_update(struct render_plan *p, int r, int k, int a, int b) {
+    int line_index = BOARD_TOP_LINE_INDEX + r;
+    int len = BOARD_W + 1;
+    struct update_line u;
+
+    u.op = LINE_OP_REPLACE;
+    u.cursors = (uint8_t)k;
+    u.src = (uint8_t)r;
+    u.from = (uint8_t)a;
+    u.n = (uint8_t)(b - a);
+    plan_vertical(&u, line_index);
+
+    int col = 0;
+    if (u.nav == NAV_RELATIVE) col = (ed_cur.line == line_index) ? ed_cur.col : MIN(ed_cur.want, len);
+    plan_motion(render_prev[r], len, col, a, &u.seek);
+
+    u.select = (struct motion){ MOT_FROM_CURSOR, 0, 1, (int8_t)(b - a) };
+    if (b == len && b - a > 1) u.select = (struct motion){ MOT_FROM_END, 0, 1, 0 };
+
+    plan_line(p, &u);
+    cursor_set(line_index, b);
+}
+
+/* rows: the ones that may differ, see rows_dirty; returns the number of
+ * edits (each one undo step in the editor) */
+static int make_board_diff(struct render_plan *p, uint16_t rows) {
+    int edits = 0;
+
+    for (int r = 0; r < BOARD_H; r++) {
+        if (!(rows & (1u << r))) continue;
+        if (row_equals(render_prev[r], render_next[r])) continue;
+
+        int bot;
+        if (move_window(rows, r, &bot)) {
+            struct render_cost lines = lines_cost(r, bot - r + 1);
+            struct editor_cursor cur = ed_cur;
+            struct render_plan move = { 0 };
+            make_line_move(&move, r, bot);
+            ed_cur = cur;
+
+            if (cost_less(&move.cost, &lines)) {
+                make_line_move(p, r, bot);
+                edits += bot - r;
+                r = bot;
+                continue;
+            }
+        }
+
+        int a, b;
+        int k = column_run(rows, r, &a, &b);
+        if (k > 1) {
+            /* one edit for the run, if that beats editing line by line */
+            struct render_cost lines = lines_cost(r, k);
+            struct editor_cursor cur = ed_cur;
+            struct render_plan column = { 0 };
+            make_column_update(&column, r, k, a, b);
+            ed_cur = cur;
+
+            if (cost_less(&column.cost, &lines)) {
+                make_column_update(p, r, k, a, b);
+                edits++;
+                r += k - 1;
+                continue;
+            }
+        }
+
+        make_line_update(p, BOARD_TOP_LINE_INDEX + r, (uint8_t)r);
+        edits++;
+    }
+    return edits;
+}
+
+/* ==============================
+ * Render engine (async plan interpreter)
+ * ============================== */
+enum plan_done { PLAN_DONE_DIFF = 0, PLAN_DONE_CLEAR, PLAN_DONE_FULL_FRAME, PLAN_DONE_CALIBRATE, PLAN_DONE_BLINK };
+
+struct render_state {
+    bool running;
+
+    uint8_t plan[RENDER_PLAN_MAX];
+    uint16_t plan_len;
+    uint16_t pc;            /* current op */
+    uint16_t rep;           /* repetitions of it done */
+    uint16_t layout_pc;     /* end of the last op changing the line layout */
+    struct frame_pos frame; /* OP_TYPE_FRAME */
+    bool shift_held;
+    uint8_t extra_cursors;  /* added below the primary one */
+    uint8_t on_done;        /* enum plan_done */
+    uint32_t rest_ms;       /* pause after the queued key's last event */
+
+    struct k_work_delayable work;
+};
+
+static struct render_state rs;
+
+/* ==============================
+ * Host flow control (lock LED acknowledgement)
+ *
+ * Keys go out FLOW_KEY_MS apart instead of their open-loop delays. Every
+ * FLOW_BATCH_KEYS keys, and at the end of a plan, a Scroll Lock tap closes the
+ * batch and the next one waits for the host's LED report: once the LED flips,
+ * the host has consumed everything typed before the toggle.
+ * ============================== */
+#if IS_ENABLED(CONFIG_ZMK_TETRIS_LED_FLOW_CONTROL)
+#define FLOW_KEY_MS     CONFIG_ZMK_TETRIS_FLOW_KEY_MS
+#define FLOW_BATCH_KEYS CONFIG_ZMK_TETRIS_FLOW_BATCH_KEYS
+#define FLOW_TIMEOUT_MS CONFIG_ZMK_TETRIS_FLOW_TIMEOUT_MS
+
+static struct {
+    bool broken;        /* host never acked: open-loop delays from now on */
+    bool outstanding;   /* a toggle the host has not reported yet */
+    bool expect_on;     /* Scroll Lock LED after our last toggle */
+    bool sync_queued;   /* the key queue holds a sync tap */
+    bool waiting;       /* render paused until ack or deadline */
+    uint16_t batch_keys;
+    int64_t deadline;
+} flow;
+
+/* ms left to wait for the ack of the last batch, 0: go on */
+static int32_t flow_wait_ms(void) {
+    if (!flow.waiting) return 0;
+
+    if (flow.outstanding) {
+        int64_t left = flow.deadline - k_uptime_get();
+        if (left > 0) return (int32_t)left;
+
+        LOG_WRN("tetris: no lock LED ack from host, using fixed key delays");
+        flow.broken = true;
+        flow.outstanding = false;
+    }
+    flow.waiting = false;
+    return 0;
+}
+
+/* Close the batch with a Scroll Lock tap when it is full or the plan is done.
+ * Never inside a Shift selection. */
+static bool flow_sync_due(bool plan_done, uint32_t *delay_ms) {
+    if (flow.broken || flow.batch_keys == 0 || rs.shift_held) return false;
+    if (!plan_done && flow.batch_keys < FLOW_BATCH_KEYS) return false;
+
+    /* a cancelled batch may still have its toggle in flight */
+    if (!flow.outstanding) {
+        flow.expect_on = (zmk_hid_indicators_get_current_profile() & LED_SCROLL_LOCK) != 0;
+    }
+    flow.expect_on = !flow.expect_on;
+    flow.outstanding = true;
+    flow.sync_queued = true;
+    flow.batch_keys = 0;
+    queue_tap(SCROLLLOCK);
+    *delay_ms = FLOW_KEY_MS;
+    return true;
+}
+
+static void flow_paced(uint32_t *delay_ms) {
+    if (flow.broken) return;
+    flow.batch_keys++;
+    *delay_ms = FLOW_KEY_MS;
+}
+
+/* the queued key went out completely */
+static void flow_key_sent(void) {
+    if (!flow.sync_queued) return;
+    flow.sync_queued = false;
+    flow.waiting = true;
+    flow.deadline = k_uptime_get() + FLOW_TIMEOUT_MS;
+}
+
+static void flow_cancel(void) {
+    flow.sync_queued = false;
+    flow.waiting = false;
+    flow.batch_keys = 0;
+}
+
+static void flow_on_leds(uint8_t leds) {
+    if (!flow.outstanding) return;
+
+    bool on = (leds & LED_SCROLL_LOCK) != 0;
+    if (on == flow.expect_on) {
+        flow.outstanding = false;
+        if (flow.waiting) k_work_reschedule(&rs.work, K_NO_WAIT);
+    }
+}
+#else
+static inline int32_t flow_wait_ms(void) { return 0; }
+static inline bool flow_sync_due(bool plan_done, uint32_t *delay_ms) {
+    ARG_UNUSED(plan_done);
+    ARG_UNUSED(delay_ms);
+    return false;
+}
+static inline void flow_paced(uint32_t *delay_ms) { ARG_UNUSED(delay_ms); }
+static inline void flow_key_sent(void) {}
+static inline void flow_cancel(void) {}
+static inline void flow_on_leds(uint8_t leds) { ARG_UNUSED(leds); }
+#endif
+
+/* ==============================
+ * HID report backpressure
+ *
+ * Every report we send takes a credit; the transport gives it back through
+ * zmk_tetris_hid_report_sent() once the report has left its queue. At
+ * HID_HIGH_WATER reports in flight the renderer stops and is woken by that
+ * call. Nothing is counted before the first ack, so a transport that never
+ * calls the hook never holds the renderer. If acks stop for
+ * HID_ACK_TIMEOUT_MS (link gone) pacing is off for good, as with the lock
+ * LED flow control. The count, the deadline and the state are shared with
+ * the transport's completion context.
+ * ============================== */
+#if IS_ENABLED(CONFIG_ZMK_TETRIS_HID_BACKPRESSURE)
+#define HID_HIGH_WATER     CONFIG_ZMK_TETRIS_HID_HIGH_WATER
+#define HID_ACK_TIMEOUT_MS CONFIG_ZMK_TETRIS_HID_ACK_TIMEOUT_MS
+
+static atomic_t hid_wait_deadline; /* k_uptime_get_32() ms, 0: not waiting */
+
+/* ms to hold the next report back, 0: go on */
+static int32_t hid_wait_ms(void) {
+    if (atomic_get(&hid_pacing) != HID_PACING_ON ||
+        atomic_get(&hid_in_flight) < HID_HIGH_WATER) {
+        atomic_set(&hid_wait_deadline, 0);
+        return 0;
+    }
+
+    uint32_t now = k_uptime_get_32();
+    uint32_t deadline = (uint32_t)atomic_get(&hid_wait_deadline);
+    if (deadline == 0) {
+        deadline = (now + HID_ACK_TIMEOUT_MS) | 1u;
+        atomic_set(&hid_wait_deadline, (atomic_val_t)deadline);
+    }
+    int32_t left = (int32_t)(deadline - now);
+    if (left > 0) return left;
+
+    LOG_WRN("tetris: HID report acks stopped, using fixed key delays");
+    atomic_set(&hid_pacing, HID_PACING_BROKEN);
+    atomic_set(&hid_in_flight, 0);
+    atomic_set(&hid_wait_deadline, 0);
+    return 0;
+}
+
+/* Acks for reports that were not ours (user keys) only make the count
+ * lower; it never goes below zero. The first ack turns pacing on. */
+void zmk_tetris_hid_report_sent(void) {
+    if (atomic_cas(&hid_pacing, HID_PACING_OFF, HID_PACING_ON)) return;
+
+    atomic_val_t n;
+    do {
+        n = atomic_get(&hid_in_flight);
+    } while (n > 0 && !atomic_cas(&hid_in_flight, n, n - 1));
+
+    if (atomic_get(&hid_wait_deadline) != 0) k_work_reschedule(&rs.work, K_NO_WAIT);
+}
+#else
+static inline int32_t hid_wait_ms(void) { return 0; }
+#endif
+
+/* game timers; see "Game tick scheduler" */
+enum game_timer { GAME_TIMER_CLEAR = 0, GAME_TIMER_SPAWN, GAME_TIMER_GRAVITY, GAME_TIMER_COUNT };
+static struct k_work_delayable game_work;
+
+/* forward */
+static void replay_held_moves(void);
+static void calib_run_done(void);
+static void invalidate_render_model(void);
+static void clear_resume(void);
+static void blink_cut(void);
+static void blink_forget(void);
+
+/* Cancel the running plan. Completely typed lines are committed already;
+ * one cut mid-typing is marked unknown and the next diff retypes it.
+ * Returns false if the cut left the editor's line layout unknown (a wipe,
+ * full frame or line delete/insert was under way): only a full redraw
+ * recovers from that. */
+static bool stop_render(void) {
+    bool layout_kept = true;
+
+    if (rs.running) {
+        if (rs.on_done == PLAN_DONE_BLINK) {
+            blink_cut();
+        } else if (rs.on_done != PLAN_DONE_DIFF || rs.pc < rs.layout_pc) {
+            layout_kept = false;
+            invalidate_render_model();
+        } else {
+            if (rs.pc < rs.plan_len && op_line_span(rs.plan[rs.pc]) && rs.rep > 0) {
+                for (int i = 0; i <= rs.extra_cursors; i++) line_prev((uint8_t)(rs.plan[rs.pc + 1] + i))[0] = '\0';
+            }
+            if (rs.pc < rs.plan_len && rs.plan[rs.pc] == OP_MOVE_LINE_UP && rs.rep > 0) {
+                /* lines moved partway */
+                for (int i = 0; i <= rs.plan[rs.pc + 2]; i++) render_prev[rs.plan[rs.pc + 1] - i][0] = '\0';
+            }
+            /* rows planned but not reached */
+            rows_dirty = ROWS_ALL;
+        }
+    }
+
+    blink_forget();
+    keyq_abort();
+    if (rs.extra_cursors > 0) {
+        /* the next plan must not type into every cursor */
+        key_send(ESCAPE, true);
+        key_send(ESCAPE, false);
+        key_flush();
+    }
+    flow_cancel();
+    rs.running = false;
+    rs.plan_len = 0;
+    rs.pc = 0;
+    rs.rep = 0;
+    rs.shift_held = false;
+    rs.extra_cursors = 0;
+    k_work_cancel_delayable(&rs.work);
+
+    /* a script may have been cut anywhere */
+    cursor_invalidate();
+    clear_resume();
+    return layout_kept;
+}
+
+static void start_plan(uint16_t len, enum plan_done on_done) {
+    /* any other edit buries the blink in the undo history */
+    if (on_done != PLAN_DONE_BLINK) blink_forget();
+
+    rs.plan_len = len;
+    plan_optimize(rs.plan, &rs.plan_len);
+    rs.pc = 0;
+    rs.rep = 0;
+    rs.shift_held = false;
+    rs.extra_cursors = 0;
+    rs.on_done = (uint8_t)on_done;
+
+    rs.layout_pc = 0;
+    for (uint16_t pc = 0; pc < rs.plan_len; pc = (uint16_t)(pc + op_size(rs.plan, pc))) {
+        if (op_changes_layout(rs.plan, pc)) rs.layout_pc = (uint16_t)(pc + op_size(rs.plan, pc));
+    }
+
+    rs.running = true;
+    k_work_reschedule(&rs.work, K_NO_WAIT);
+}
+
+/* queue the key events of one repetition of `op` */
+static void queue_op_keys(uint8_t op, char c) {
+    uint32_t kc;
+
+    switch (op) {
+    case OP_DOC_START: queue_tap_with_mod(LCTRL, HOME); break;
+    case OP_DOC_END: queue_tap_with_mod(LCTRL, END); break;
+    case OP_UP: queue_tap(UP); break;
+    case OP_DOWN: queue_tap(DOWN); break;
+    case OP_LEFT: queue_tap(LEFT); break;
+    case OP_RIGHT: queue_tap(RIGHT); break;
+    case OP_WORD_LEFT: queue_tap_with_mod(LCTRL, LEFT); break;
+    case OP_WORD_RIGHT: queue_tap_with_mod(LCTRL, RIGHT); break;
+    case OP_HOME: queue_tap(HOME); break;
+    case OP_LINE_END: queue_tap(END); break;
+    case OP_SHIFT_PRESS: queue_press(LSHIFT); break;
+    case OP_SHIFT_RELEASE: queue_release(LSHIFT); break;
+    case OP_DELETE_LINE: queue_tap(LC(LS(K))); break;
+    case OP_DUPLICATE_LINE: queue_tap(LS(LA(DOWN))); break;
+    case OP_MOVE_LINE_UP: queue_tap(LA(UP)); break;
+    case OP_UNDO: queue_tap_with_mod(LCTRL, Z); break;
+    case OP_REDO: queue_tap_with_mod(LCTRL, Y); break;
+    case OP_ADD_CURSOR_DOWN: queue_tap(LC(LA(DOWN))); break;
+    case OP_SINGLE_CURSOR: queue_tap(ESCAPE); break;
+    case OP_SELECT_ALL: queue_tap_with_mod(LCTRL, A); break;
+    case OP_BACKSPACE: queue_tap(BACKSPACE); break;
+    case OP_DELETE_SPAN: queue_tap(DELETE); break;
+    case OP_TYPE:
+    case OP_TYPE_LINE:
+    case OP_INSERT_LINE:
+    case OP_TYPE_FRAME:
+        if (char_to_keycode(c, &kc)) queue_tap(kc);
+        break;
+    case OP_LOCK_TOGGLE: queue_tap(SCROLLLOCK); break;
+    default:
+        break;
+    }
+}
+
+/* build a game line from the frame snapshot, right before it is typed
+ * (score_next is built with the snapshot) */
+static void bind_line(uint8_t src) {
+    if (src != LINE_SRC_SCORE) build_row_string(src, render_next[src]);
+}
+
+/* OP_TYPE_LINE: char `col` of line `src` */
+static char type_line_char(uint8_t src, int col, bool bind) {
+    if (bind) bind_line(src);
+    return line_next(src)[col];
+}
+
+/* An OP_TYPE_LINE span went out completely: the editor shows it now, on
+ * line `src` and on the `extra` board rows below it that had a cursor
+ * (planned with the same text there). */
+static void commit_line_span(uint8_t src, int from, int n, int extra) {
+    const char *next = line_next(src);
+    for (int k = 0; k <= extra; k++) {
+        char *prev = line_prev((uint8_t)(src + k));
+        for (int i = from; i < from + n; i++) prev[i] = next[i];
+        if (next[from + n] == '\0') prev[from + n] = '\0';
+    }
+}
+
+/* OP_MOVE_LINE_UP went out: row `src` sits n rows higher, those below it */
+static void commit_line_move(int src, int n) {
+    char moved[BOARD_W + 2];
+    for (int i = 0; i < BOARD_W + 2; i++) moved[i] = render_prev[src][i];
+    for (int r = src; r > src - n; r--) {
+        for (int i = 0; i < BOARD_W + 2; i++) render_prev[r][i] = render_prev[r - 1][i];
+    }
+    for (int i = 0; i < BOARD_W + 2; i++) render_prev[src - n][i] = moved[i];
+}
+
+/* OP_INSERT_LINE / OP_DELETE_SPAN went out: the rest of the line shifted */
+static void commit_line_patch(uint8_t op, uint8_t src, int from, int n) {
+    const char *next = line_next(src);
+    char *prev = line_prev(src);
+    int len = 0;
+    while (prev[len]) len++;
+
+    if (op == OP_DELETE_SPAN) {
+        for (int i = from; i < len; i++) prev[i] = (i + n < len) ? prev[i + n] : '\0';
+        return;
+    }
+    for (int i = len; i >= from; i--) prev[i + n] = prev[i];
+    for (int i = from; i < from + n; i++) prev[i] = next[i];
+}
+
+/* bind the rows below board row `r` as long as they equal it; returns
+ * how many do (made with duplicate-line instead of typed) */
+static uint8_t frame_bind_run(int r, bool commit) {
+    uint8_t k = 0;
+    for (int n = r + 1; n < BOARD_H; n++, k++) {
+        build_row_string(n, render_next[n]);
+        if (!row_equals(render_next[n], render_next[r])) break;
+        if (commit) {
+            for (int i = 0; i < BOARD_W + 2; i++) render_prev[n][i] = render_next[n][i];
+        }
+    }
+    return k;
+}
+
+/* Next key of the full frame from `f`: a char to type (*c), a duplicate-line
+ * tap, or done. Game lines are bound when typing reaches them; a board row
+ * also binds the identical rows right below it, which are copied instead of
+ * typed. With `commit` the bound lines go into the render model (a cut
+ * frame invalidates it anyway). */
+static enum frame_key frame_next(struct frame_pos *f, bool commit, char *c) {
+    if (f->line >= LAST_LINE_INDEX) return FRAME_KEY_DONE;
+
+    uint8_t len = frame_line_len(f->line);
+    if (f->col < len) {
+        if (f->line == 0) {
+            *c = FRAME_TITLE[f->col++];
+            return FRAME_KEY_CHAR;
+        }
+
+        uint8_t src = (f->line == 1) ? LINE_SRC_SCORE : (uint8_t)(f->line - BOARD_TOP_LINE_INDEX);
+        const char *next = line_next(src);
+        if (f->col == 0) {
+            bind_line(src);
+            if (commit) {
+                char *prev = line_prev(src);
+                for (int k = 0; k <= len; k++) prev[k] = next[k];
+            }
+            if (src != LINE_SRC_SCORE) f->dups = frame_bind_run(src, commit);
+        }
+        *c = next[f->col++];
+        return FRAME_KEY_CHAR;
+    }
+
+    /* at the end of a row: copy it down, or start the next line */
+    f->line++;
+    if (f->dups > 0) {
+        f->dups--;
+        return FRAME_KEY_DUP;
+    }
+    f->col = 0;
+    *c = '\n';
+    return FRAME_KEY_CHAR;
+}
+
+/* queue the next key of the plan; false once it is exhausted */
+static bool plan_step(uint32_t *delay_ms) {
+    while (rs.pc < rs.plan_len) {
+        uint8_t op = rs.plan[rs.pc];
+        uint16_t n = op_counted(op) ? rs.plan[rs.pc + 1] : 1;
+        char c = 0;
+
+        if (op == OP_TYPE && rs.rep < n) c = (char)rs.plan[rs.pc + 2 + rs.rep];
+        if (op == OP_MOVE_LINE_UP) n = rs.plan[rs.pc + 2];
+        if (op_line_span(op)) {
+            n = rs.plan[rs.pc + 3];
+            if (op != OP_DELETE_SPAN && rs.rep < n) {
+                c = type_line_char(rs.plan[rs.pc + 1], rs.plan[rs.pc + 2] + rs.rep, rs.rep == 0);
+            }
+        }
+        uint8_t key_op = op;
+        if (op == OP_TYPE_FRAME) {
+            if (rs.rep == 0) rs.frame = (struct frame_pos){ 0 };
+            enum frame_key key = frame_next(&rs.frame, true, &c);
+            n = (key == FRAME_KEY_DONE) ? rs.rep : (uint16_t)(rs.rep + 1);
+            if (key == FRAME_KEY_DUP) key_op = OP_DUPLICATE_LINE;
+        }
+
+        if (rs.rep >= n) {
+            /* the previous key is out, so the whole span is */
+            if (op == OP_TYPE_LINE) commit_line_span(rs.plan[rs.pc + 1], rs.plan[rs.pc + 2], n, rs.extra_cursors);
+            else if (op_line_span(op)) commit_line_patch(op, rs.plan[rs.pc + 1], rs.plan[rs.pc + 2], n);
+            else if (op == OP_MOVE_LINE_UP) commit_line_move(rs.plan[rs.pc + 1], n);
+            rs.pc = (uint16_t)(rs.pc + op_size(rs.plan, rs.pc));
+            rs.rep = 0;
+            continue;
+        }
+
+        *delay_ms = op_delay(key_op, c, rs.shift_held);
+        queue_op_keys(key_op, c);
+        if (op == OP_SHIFT_PRESS) rs.shift_held = true;
+        else if (op == OP_SHIFT_RELEASE) rs.shift_held = false;
+        else if (op == OP_ADD_CURSOR_DOWN) rs.extra_cursors++;
+        else if (op == OP_SINGLE_CURSOR) rs.extra_cursors = 0;
+        rs.rep++;
+        return true;
+    }
+    return false;
+}
+
+/* plan generators: wipe the editor, optionally retype the whole frame */
+static void plan_clear_editor(struct render_plan *p) {
+    plan_op(p, OP_SELECT_ALL);
+    plan_op_n(p, OP_BACKSPACE, 1);
+}
+
+/* the frame is costed from the snapshot, key by key */
+static void plan_full_frame(struct render_plan *p) {
+    plan_clear_editor(p);
+    plan_put(p, OP_TYPE_FRAME);
+
+    struct frame_pos f = { 0 };
+    enum frame_key key;
+    char c = 0;
+    while ((key = frame_next(&f, false, &c)) != FRAME_KEY_DONE) {
+        plan_charge(p, key == FRAME_KEY_DUP ? OP_DUPLICATE_LINE : OP_TYPE_FRAME, c);
+    }
+}
+
+static void start_clear_only(void) {
+    struct render_plan p = { .buf = rs.plan, .cap = RENDER_PLAN_MAX };
+    plan_clear_editor(&p);
+    start_plan(p.len, PLAN_DONE_CLEAR);
+}
+
+static void start_full_redraw(void) {
+    struct render_plan p = { .buf = rs.plan, .cap = RENDER_PLAN_MAX };
+    frame_capture();
+    plan_full_frame(&p);
+    start_plan(p.len, PLAN_DONE_FULL_FRAME);
+}
+
+/* ==============================
+ * Renderer: line clears
+ *
+ * Collapsing rows shifts everything above them, which a plain diff would
+ * retype. Instead the cleared lines are deleted in the editor (Ctrl+Shift+K)
+ * and as many blank rows are typed in at the top of the board.
+ * ============================== */
+static uint16_t render_clear_mask; /* rows collapsed by the game since the last frame */
+
+static void render_note_line_clear(uint16_t mask) {
+    render_clear_mask = mask;
+}
+
+/* the editor shows the current blink phase on every cleared row */
+static bool render_shows_blink(void) {
+    char c = ((clear_step % 2) == 0) ? '=' : '.';
+    for (int r = 0; r < BOARD_H; r++) {
+        if (!(clear_mask & (1u << r))) continue;
+        for (int i = 0; i < BOARD_W; i++) {
+            if (render_prev[r][i] != c) return false;
+        }
+    }
+    return true;
+}
+
+/* apply_line_clear() for what the editor will show after the delete/insert ops */
+static void shift_render_rows(uint16_t mask) {
+    int dst = BOARD_H - 1;
+    for (int src = BOARD_H - 1; src >= 0; src--) {
+        if (mask & (1u << src)) continue;
+        if (dst != src) {
+            for (int i = 0; i < BOARD_W + 2; i++) render_prev[dst][i] = render_prev[src][i];
+        }
+        dst--;
+    }
+    for (int r = dst; r >= 0; r--) {
+        for (int c = 0; c < BOARD_W; c++) render_prev[r][c] = '.';
+        render_prev[r][BOARD_W] = ' ';
+        render_prev[r][BOARD_W + 1] = '\0';
+    }
+}
+
+static void plan_line_clear(struct render_plan *p, uint16_t mask) {
+    int deleted = 0;
+
+    /* top-down: each deletion pulls the following rows up by one */
+    for (int r = 0; r < BOARD_H; r++) {
+        if (!(mask & (1u << r))) continue;
+        make_line_delete(p, BOARD_TOP_LINE_INDEX + r - deleted);
+        deleted++;
+    }
+
+    char blank[BOARD_W + 2];
+    for (int i = 0; i < BOARD_W; i++) blank[i] = '.';
+    blank[BOARD_W] = ' ';
+    blank[BOARD_W + 1] = '\0';
+
+    for (int i = 0; i < deleted; i++) make_line_insert(p, BOARD_TOP_LINE_INDEX + i, blank);
+
+    shift_render_rows(mask);
+}
+
+/* saved renderer model, to cost alternative plans */
+struct render_snapshot {
+    char rows[BOARD_H][BOARD_W + 2];
+    char score[UPDATE_TEXT_MAX];
+    struct editor_cursor cur;
+};
+
+static void render_save(struct render_snapshot *snap) {
+    for (int r = 0; r < BOARD_H; r++)
+        for (int i = 0; i < BOARD_W + 2; i++) snap->rows[r][i] = render_prev[r][i];
+    for (int i = 0; i < UPDATE_TEXT_MAX; i++) snap->score[i] = score_prev[i];
+    snap->cur = ed_cur;
+}
+
+static void render_restore(const struct render_snapshot *snap) {
+    for (int r = 0; r < BOARD_H; r++)
+        for (int i = 0; i < BOARD_W + 2; i++) render_prev[r][i] = snap->rows[r][i];
+    for (int i = 0; i < UPDATE_TEXT_MAX; i++) score_prev[i] = snap->score[i];
+    ed_cur = snap->cur;
+}
+
+/* forget what the editor shows: the next diff replaces every line */
+static void invalidate_render_model(void) {
+    for (int r = 0; r < BOARD_H; r++) {
+        for (int i = 0; i < BOARD_W + 2; i++) render_prev[r][i] = '\0';
+    }
+    score_prev[0] = '\0';
+    render_clear_mask = 0;
+    rows_dirty = ROWS_ALL;
+}
+
+/* some line is known: the editor still holds our line layout */
+static bool render_layout_known(void) {
+    if (score_prev[0] != '\0') return true;
+    for (int r = 0; r < BOARD_H; r++) {
+        if (render_prev[r][0] != '\0') return true;
+    }
+    return false;
+}
+
+static bool render_model_known(void) {
+    if (ed_cur.line < 0 || score_prev[0] == '\0') return false;
+    for (int r = 0; r < BOARD_H; r++) {
+        if (render_prev[r][0] == '\0') return false;
+    }
+    return true;
+}
+
+/* ==============================
+ * Renderer: line clear blink via undo/redo
+ *
+ * The blink alternates the cleared rows between two texts. Once a diff has
+ * typed one of them over the other and nothing else, the editor's undo
+ * history holds both: Ctrl+Z shows the old one again and Ctrl+Y the new
+ * one, a chord per edit of that diff instead of retyping the rows. Any other
+ * plan, or a cut, makes the history unusable.
+ * ============================== */
+static struct {
+    uint16_t mask;      /* cleared rows of the usable history, 0: none */
+    uint8_t edits;      /* undo steps the blink typing took */
+    bool on;            /* it typed the '=' rows */
+    bool undone;        /* the editor shows the rows from before it */
+
+    uint16_t pending;   /* mask of the running diff, if it types a blink */
+    uint8_t pending_edits;
+    bool pending_from;  /* the text it types over */
+} blink;
+
+/* 1: blink row on ('='), 0: off ('.'), -1: neither */
+static int blink_row_state(const char *row) {
+    char c = row[0];
+    if (c != '=' && c != '.') return -1;
+    for (int i = 0; i < BOARD_W; i++) {
+        if (row[i] != c) return -1;
+    }
+    if (row[BOARD_W] != ' ' || row[BOARD_W + 1] != '\0') return -1;
+    return c == '=';
+}
+
+/* state all rows in `mask` of `rows` show, -1 if they differ */
+static int blink_rows_state(char rows[BOARD_H][BOARD_W + 2], uint16_t mask) {
+    int state = -1;
+    for (int r = 0; r < BOARD_H; r++) {
+        if (!(mask & (1u << r))) continue;
+        int s = blink_row_state(rows[r]);
+        if (s < 0 || (state >= 0 && s != state)) return -1;
+        state = s;
+    }
+    return state;
+}
+
+/* the captured frame changes nothing but its blink rows, all of them rebuilt */
+static bool blink_only(uint16_t dirty) {
+    uint16_t mask = frame.blink;
+    if (!mask || !score_equals() || (dirty & mask) != mask) return false;
+    for (int r = 0; r < BOARD_H; r++) {
+        if ((dirty & (1u << r)) && !(mask & (1u << r)) && !row_equals(render_prev[r], render_next[r])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void blink_forget(void) {
+    blink.mask = 0;
+    blink.pending = 0;
+}
+
+/* a flip was cut: the rows may show either text */
+static void blink_cut(void) {
+    for (int r = 0; r < BOARD_H; r++) {
+        if (blink.mask & (1u << r)) render_prev[r][0] = '\0';
+    }
+    rows_dirty = ROWS_ALL;
+}
+
+/* the diff just started: remember it if it retypes every cleared row from
+ * one blink text to the other */
+static void blink_note_plan(uint16_t clear, uint16_t dirty, int edits) {
+    if (clear || edits <= 0 || edits > 255 || !blink_only(dirty)) return;
+
+    int from = blink_rows_state(render_prev, frame.blink);
+    if (from < 0) return;
+    blink.pending = frame.blink;
+    blink.pending_edits = (uint8_t)edits;
+    blink.pending_from = (from == 1);
+}
+
+/* the diff finished; rows are bound as typed, so check what went out */
+static void blink_typed(void) {
+    uint16_t mask = blink.pending;
+    blink.pending = 0;
+    if (!mask) return;
+
+    int state = blink_rows_state(render_prev, mask);
+    if (state < 0 || state == (int)blink.pending_from) return;
+    blink.mask = mask;
+    blink.edits = blink.pending_edits;
+    blink.on = (state == 1);
+    blink.undone = false;
+}
+
+/* Ctrl+Z / Ctrl+Y to the blink text of the next frame. Undo restores the
+ * selections from before the edits, maybe several cursors: Escape, and the
+ * cursor is unknown afterwards. */
+static bool plan_blink_flip(struct render_plan *p, uint16_t dirty) {
+    if (!blink.mask || blink.mask != frame.blink || !blink_only(dirty)) return false;
+
+    bool shown = blink.undone ? !blink.on : blink.on;
+    if (blink_rows_state(render_prev, blink.mask) != (int)shown) return false;
+    if (blink_rows_state(render_next, blink.mask) != (int)!shown) return false;
+
+    plan_op_n(p, blink.undone ? OP_REDO : OP_UNDO, blink.edits);
+    plan_op(p, OP_SINGLE_CURSOR);
+    return true;
+}
+
+static void blink_flipped(void) {
+    blink.undone = !blink.undone;
+    bool shown = blink.undone ? !blink.on : blink.on;
+    for (int r = 0; r < BOARD_H; r++) {
+        if (!(blink.mask & (1u << r))) continue;
+        for (int c = 0; c < BOARD_W; c++) render_prev[r][c] = shown ? '=' : '.';
+        render_prev[r][BOARD_W] = ' ';
+        render_prev[r][BOARD_W + 1] = '\0';
+    }
+}
+
+/* Plan the edits for one frame. Line edits are committed to the renderer
+ * model once they are typed; only the delete/insert ops of a line clear
+ * shift it here. score_next / render_next (at least the dirty rows) must
+ * be built. Returns the number of board edits. */
+static int plan_frame(struct render_plan *p, uint16_t clear, uint16_t dirty) {
+    if (clear) plan_line_clear(p, clear);
+
+    /* score line (line 1) */
+    if (!score_equals()) make_line_update(p, 1, LINE_SRC_SCORE);
+
+    /* board diff */
+    return make_board_diff(p, dirty);
+}
+
+/* Compile a diff plan (line clear ops, score line, board lines) and run
+ * it, or wipe and retype the editor when that is cheaper (game-over wipes,
+ * big clears). Lines are planned top-down, so apart from a line clear the
+ * plan is one downward pass of relative cursor moves. */
+static void render_frame(bool allow_full) {
+    if (rs.running) return;
+
+    /* only rows a game event touched can differ */
+    uint16_t dirty = rows_dirty;
+    rows_dirty = 0;
+
+    frame_capture();
+    rebuild_render_rows(dirty);
+
+    /* delete/insert only pays off if the editor content is known */
+    uint16_t clear = render_clear_mask;
+    render_clear_mask = 0;
+    if (clear && !render_model_known()) clear = 0;
+    if (clear) {
+        struct render_snapshot snap;
+        struct render_plan plain = { 0 }, shifted = { 0 };
+
+        render_save(&snap);
+        plan_frame(&plain, 0, dirty);
+        render_restore(&snap);
+        plan_frame(&shifted, clear, dirty);
+        render_restore(&snap);
+
+        if (!cost_less(&shifted.cost, &plain.cost)) clear = 0;
+    }
+
+    struct render_plan p = { .buf = rs.plan, .cap = RENDER_PLAN_MAX };
+    int edits = plan_frame(&p, clear, dirty);
+    if (p.len == 0) return;
+
+    struct render_plan flip = { 0 };
+    if (!clear && plan_blink_flip(&flip, dirty) && cost_less(&flip.cost, &p.cost)) {
+        p = (struct render_plan){ .buf = rs.plan, .cap = RENDER_PLAN_MAX };
+        plan_blink_flip(&p, dirty);
+        cursor_invalidate();
+        start_plan(p.len, PLAN_DONE_BLINK);
+        return;
+    }
+
+    /* an overflowing plan can only be replaced by a full redraw */
+    if (allow_full || p.overflow) {
+        struct render_plan full = { 0 };
+        plan_full_frame(&full);
+        if (p.overflow || cost_less(&full.cost, &p.cost)) {
+            LOG_DBG("tetris full redraw: %u ms < diff %u ms", full.cost.ms, p.cost.ms);
+            start_full_redraw();
             return;
+        }
+    }
+
+    start_plan(p.len, PLAN_DONE_DIFF);
+    blink_note_plan(clear, dirty, edits);
+}
+
+static void request_diff_render(void) {
+    render_frame(true);
+}
 
-        case SPH_BACKSPACE:
-            tap(BACKSPACE);
-            rs.phase = SPH_TYPE_LINE;
-            rs.line_idx = 0;
-            k_work_reschedule(&rs.work, K_MSEC(delay_action()));
-            return;
+static void force_redraw_all(void) {
+    /* render_prevを全消しして差分を“全行”にする (editor is not wiped) */
+    invalidate_render_model();
+    render_frame(false);
+}
 
-        case SPH_TYPE_LINE: {
-            char c = rs.line_text[rs.line_idx];
-            if (c == '\0') {
-                rs.phase = SPH_DONE;
-                k_work_reschedule(&rs.work, K_MSEC(delay_action()));
-                return;
-            }
-            uint32_t kc;
-            if (char_to_keycode(c, &kc)) tap(kc);
-            rs.line_idx++;
-            k_work_reschedule(&rs.work, K_MSEC(delay_for_char(c)));
-            return;
-        }
+static void finish_plan(void) {
+    key_flush();
+
+    if (rs.on_done == PLAN_DONE_FULL_FRAME) {
+        /* lines were committed as they were typed; the frame ends with a newline after the last board row */
+        cursor_set(LAST_LINE_INDEX, 0);
+    } else if (rs.on_done == PLAN_DONE_CLEAR) {
+        cursor_set(0, 0);
+    } else if (rs.on_done == PLAN_DONE_BLINK) {
+        blink_flipped();
+    } else if (rs.on_done == PLAN_DONE_DIFF) {
+        blink_typed();
+    }
 
-        case SPH_DONE:
-        default:
-            if (rs.batch_pos + 1 < rs.batch_len) {
-                rs.batch_pos++;
-                start_replace_line_script(rs.batch[rs.batch_pos].line_index,
-                                          rs.batch[rs.batch_pos].text);
-                return;
-            }
+    rs.running = false;
+    rs.plan_len = 0;
+    rs.pc = 0;
+    rs.rep = 0;
+
+    if (rs.on_done == PLAN_DONE_CALIBRATE) {
+        calib_run_done();
+        return;
+    }
+
+    /* a cleared editor stays empty until the next command draws it */
+    if (rs.on_done == PLAN_DONE_CLEAR) return;
+
+    /* the game moved on while we typed: render its latest state */
+    request_diff_render();
+    clear_resume();
+}
 
-            rs.running = false;
-            rs.mode = RENDER_IDLE;
-            rs.batch_len = 0;
-            rs.batch_pos = 0;
+/* queue the next key: a plan key, or a sync tap closing the batch */
+static bool render_next_key(uint32_t *delay_ms) {
+    /* calibration measures the open-loop delays themselves */
+    if (rs.on_done == PLAN_DONE_CALIBRATE) return plan_step(delay_ms);
 
-            apply_pending_and_redraw_once();
+    if (flow_sync_due(false, delay_ms)) return true;
+    if (plan_step(delay_ms)) {
+        flow_paced(delay_ms);
+        return true;
+    }
+    return flow_sync_due(true, delay_ms);
+}
+
+static void render_work_handler(struct k_work *work) {
+    ARG_UNUSED(work);
+    if (!rs.running) return;
+
+    int32_t hid_ms = hid_wait_ms();
+    if (hid_ms > 0) {
+        k_work_reschedule(&rs.work, K_MSEC(hid_ms));
+        return;
+    }
+
+    if (keyq_idle()) {
+        int32_t wait_ms = flow_wait_ms();
+        if (wait_ms > 0) {
+            k_work_reschedule(&rs.work, K_MSEC(wait_ms));
+            return;
+        }
+
+        uint32_t delay_ms;
+        if (!render_next_key(&delay_ms)) {
+            finish_plan();
             return;
         }
+
+        /* the key's delay runs from its first event to the next key */
+        uint32_t hold_ms = (uint32_t)(keyq.len - 1) * KEY_HOLD_MS;
+        rs.rest_ms = (delay_ms > hold_ms) ? delay_ms - hold_ms : 0;
     }
 
-    rs.running = false;
-    rs.mode = RENDER_IDLE;
-    rs.batch_len = 0;
-    rs.batch_pos = 0;
+    keyq_send_next();
+    if (keyq_idle()) flow_key_sent();
+    k_work_reschedule(&rs.work, K_MSEC(keyq_idle() ? rs.rest_ms : KEY_HOLD_MS));
 }
 
+
 /* ==============================
- * Gravity / Clear / Spawn scheduling
+ * Game tick scheduler
+ *
+ * Clear animation, spawn delay and gravity each hold an absolute deadline.
+ * One delayable work wakes at the earliest and runs every due timer in
+ * enum order: a clear step before the spawn it leads to, the spawn before
+ * the new piece's gravity. Nothing polls; a timer waiting for some state
+ * is not armed until that state arms it (a spawn arms gravity). Pausing
+ * freezes the deadlines, resuming shifts them by the time spent paused.
  * ============================== */
+#define GAME_TIMER_OFF INT64_MAX
+
+static int64_t game_due[GAME_TIMER_COUNT] = { GAME_TIMER_OFF, GAME_TIMER_OFF, GAME_TIMER_OFF };
+static int64_t paused_at;
+
+/* (re)arm the work for the earliest deadline */
+static void game_timers_kick(void) {
+    if (paused) return;
+
+    int64_t next = GAME_TIMER_OFF;
+    for (int t = 0; t < GAME_TIMER_COUNT; t++) next = MIN(next, game_due[t]);
+    if (next == GAME_TIMER_OFF) {
+        k_work_cancel_delayable(&game_work);
+        return;
+    }
+
+    int64_t wait = next - k_uptime_get();
+    k_work_reschedule(&game_work, K_MSEC(wait > 0 ? wait : 0));
+}
+
+static void game_timer_at(enum game_timer t, int64_t at) {
+    game_due[t] = at;
+    game_timers_kick();
+}
+
+static void game_timer_in(enum game_timer t, uint32_t ms) {
+    game_timer_at(t, k_uptime_get() + ms);
+}
+
+static void game_timers_stop(void) {
+    for (int t = 0; t < GAME_TIMER_COUNT; t++) game_due[t] = GAME_TIMER_OFF;
+    clear_waits_render = false;
+    k_work_cancel_delayable(&game_work);
+}
+
 static void schedule_gravity_idle(void) {
-    k_work_reschedule(&gravity_work, K_MSEC(idle_before_fall_ms));
+    game_timer_in(GAME_TIMER_GRAVITY, idle_before_fall_ms);
 }
-static void schedule_gravity_interval(void) {
-    k_work_reschedule(&gravity_work, K_MSEC(fall_interval_ms));
+
+static void game_set_paused(bool on) {
+    if (on == paused) return;
+    paused = on;
+
+    if (on) {
+        paused_at = k_uptime_get();
+        k_work_cancel_delayable(&game_work);
+        return;
+    }
+
+    int64_t away = k_uptime_get() - paused_at;
+    for (int t = 0; t < GAME_TIMER_COUNT; t++) {
+        if (game_due[t] != GAME_TIMER_OFF) game_due[t] += away;
+    }
+    schedule_gravity_idle();
 }
 
 static void on_user_input_common(void) {
@@ -949,24 +2655,27 @@ static void on_user_input_common(void) {
 
 static void begin_spawn_delay(uint16_t delay_ms) {
     has_falling = false;                 /* hide next piece during delay */
+    mark_piece_dirty();
     pending_spawn_delay_ms = delay_ms;
     request_diff_render();               /* redraw board without piece if needed */
-    k_work_reschedule(&spawn_work, K_MSEC(delay_ms));
+    game_timer_in(GAME_TIMER_SPAWN, delay_ms);
 }
 
 static void begin_clear_animation(uint16_t mask) {
     clearing = true;
     clear_mask = mask;
     clear_step = 0;
+    clear_waits_render = false;
+    rows_dirty |= mask;
 
     request_diff_render();
-    k_work_reschedule(&clear_work, K_MSEC(clear_frame_ms));
+    game_timer_in(GAME_TIMER_CLEAR, clear_frame_ms);
 }
 
 static bool do_fall_one(void) {
     int ny = falling.y + 1;
     if (has_falling && can_place(falling.type, falling.rot, falling.x, ny)) {
-        falling.y = ny;
+        move_falling(falling.x, ny, falling.rot);
         return true;
     }
     return false;
@@ -975,6 +2684,7 @@ static bool do_fall_one(void) {
 static void on_piece_landed(void) {
     lock_falling();
     has_falling = false;
+    mark_piece_dirty();
 
     uint16_t mask = detect_full_lines();
     if (mask) {
@@ -994,29 +2704,33 @@ static void on_piece_landed(void) {
 
 static void hard_drop_and_land(void) {
     if (!has_falling) return;
-    while (do_fall_one()) { /* drop */ }
+    int dy = drop_distance(falling.type, falling.rot, falling.x, falling.y);
+    move_falling(falling.x, falling.y + dy, falling.rot);
     on_piece_landed();
 }
 
-/* clear animation worker */
-static void clear_work_handler(struct k_work *work) {
-    ARG_UNUSED(work);
-    if (paused) {
-        k_work_reschedule(&clear_work, K_MSEC(100));
-        return;
-    }
+/* Clear animation step. Frames skip to the latest game state, but each
+ * blink phase is drawn: a step falling due before its phase is on screen
+ * waits for the renderer to finish it (clear_resume). */
+static void clear_tick(void) {
     if (!clearing) return;
 
-    if (rs.running) {
-        k_work_reschedule(&clear_work, K_MSEC(30));
-        return;
+    if (!render_shows_blink()) {
+        rows_dirty |= clear_mask;
+        request_diff_render();
+        if (rs.running) {
+            clear_waits_render = true;
+            return;
+        }
+        /* nothing the renderer can type: do not hold the game */
     }
 
     clear_step++;
+    rows_dirty |= clear_mask;
 
     if (clear_step < clear_frames) {
         request_diff_render();
-        k_work_reschedule(&clear_work, K_MSEC(clear_frame_ms));
+        game_timer_in(GAME_TIMER_CLEAR, clear_frame_ms);
         return;
     }
 
@@ -1025,169 +2739,330 @@ static void clear_work_handler(struct k_work *work) {
     clearing = false;
     clear_mask = 0;
     clear_step = 0;
+    rows_dirty |= mask;
 
     apply_line_clear(mask);
+    render_note_line_clear(mask);
 
     begin_spawn_delay(post_clear_spawn_delay_ms);
 }
 
-/* spawn delay worker */
-static void spawn_work_handler(struct k_work *work) {
-    ARG_UNUSED(work);
-
-    if (paused) {
-        k_work_reschedule(&spawn_work, K_MSEC(100));
-        return;
-    }
-    if (clearing) {
-        k_work_reschedule(&spawn_work, K_MSEC(30));
-        return;
-    }
-    if (rs.running) {
-        k_work_reschedule(&spawn_work, K_MSEC(30));
-        return;
-    }
+/* a clear step waiting for its phase runs once the phase is on screen
+ * or the renderer stopped */
+static void clear_resume(void) {
+    if (!clear_waits_render) return;
+    if (rs.running && !render_shows_blink()) return;
+    clear_waits_render = false;
+    game_timer_in(GAME_TIMER_CLEAR, 0);
+}
 
+/* end of the spawn delay */
+static void spawn_tick(void) {
     spawn_piece();
     has_falling = true;
+    mark_piece_dirty();
+    replay_held_moves();
 
     request_diff_render();
     schedule_gravity_idle();
 }
 
-/* gravity worker */
-static void gravity_work_handler(struct k_work *work) {
-    ARG_UNUSED(work);
-    if (paused) {
-        /* paused: do nothing, keep stopped */
-        k_work_reschedule(&gravity_work, K_MSEC(100));
-        return;
-    }
-    if (clearing) {
-        k_work_reschedule(&gravity_work, K_MSEC(50));
-        return;
-    }
-    if (!has_falling) {
-        k_work_reschedule(&gravity_work, K_MSEC(50));
-        return;
-    }
+/* Gravity step due at `due`; without a piece it stays off until the next
+ * spawn. Falls are chained on absolute deadlines, so the period does not
+ * stretch by the wakeup latency, and a late wakeup drops every row owed
+ * since `due` at once (one frame for all of them). */
+static void gravity_tick(int64_t due) {
+    if (clearing || !has_falling) return;
 
-    uint32_t now = (uint32_t)k_uptime_get();
-    uint32_t since_input = now - last_input_ms;
+    int64_t now = k_uptime_get();
+    uint32_t since_input = (uint32_t)now - last_input_ms;
 
     if (since_input < idle_before_fall_ms) {
-        uint32_t remain = idle_before_fall_ms - since_input;
-        if (remain < 50) remain = 50;
-        k_work_reschedule(&gravity_work, K_MSEC(remain));
+        game_timer_in(GAME_TIMER_GRAVITY, idle_before_fall_ms - since_input);
         return;
     }
 
-    if (rs.running) {
-        k_work_reschedule(&gravity_work, K_MSEC(30));
-        return;
-    }
+    uint32_t interval = MAX(fall_interval_ms, 1);
+    int64_t owed = 1 + (now - due) / interval;
+    if (owed > BOARD_H) owed = BOARD_H;
 
-    if (do_fall_one()) {
-        request_diff_render();
-        schedule_gravity_interval();
-        return;
+    for (int i = 0; i < owed; i++) {
+        if (!do_fall_one()) {
+            last_land_was_harddrop = false;
+            on_piece_landed();
+            return;
+        }
     }
 
-    last_land_was_harddrop = false;
-    on_piece_landed();
+    request_diff_render();
+    game_timer_at(GAME_TIMER_GRAVITY, due + owed * interval);
+}
+
+static void game_work_handler(struct k_work *work) {
+    ARG_UNUSED(work);
+    if (paused) return;
+
+    int64_t now = k_uptime_get();
+    for (int t = 0; t < GAME_TIMER_COUNT; t++) {
+        int64_t due = game_due[t];
+        if (due > now) continue;
+        game_due[t] = GAME_TIMER_OFF;
+
+        switch (t) {
+        case GAME_TIMER_CLEAR: clear_tick(); break;
+        case GAME_TIMER_SPAWN: spawn_tick(); break;
+        case GAME_TIMER_GRAVITY: gravity_tick(due); break;
+        default: break;
+        }
+    }
+    game_timers_kick();
 }
 
 /* ==============================
- * Input handling (queue while rendering / clearing / spawn-delay)
+ * Draw delay calibration (cmd 4)
+ *
+ * Types a test pattern on the empty last line with a Scroll Lock tap after
+ * every char, then selects and deletes it again, at shrinking fractions of
+ * the current delays. A run passes when the host reported every toggle back
+ * through the LED. The fastest level passing CAL_RUNS runs in a row is kept
+ * and saved. The LED round trip covers transport and OS input; the editor
+ * dropping text is not visible to it.
  * ============================== */
-static void apply_pending_and_redraw_once(void) {
-    if (rs.running || clearing) return;
-    if (!has_falling) return;
+#if IS_ENABLED(CONFIG_ZMK_TETRIS_CALIBRATION)
+#define CAL_RUNS      2    /* passes needed per level */
+#define CAL_SETTLE_MS 300  /* wait for late LED reports after a run */
+
+/* even length: the LED ends up where it started */
+static const char cal_pattern[] = "tetris calibrate 0123456789 x.=-";
+static const uint8_t cal_levels_pct[] = { 100, 80, 65, 50, 40, 30, 25, 20, 15 };
+
+static struct {
+    bool active;
+    bool was_paused;
+    bool found;          /* some level passed */
+    bool dirty;          /* a failed run may have left text behind */
+    uint8_t level;
+    uint8_t run;
+    struct draw_delays base;
+    struct draw_delays good;
+    uint8_t leds;        /* last reported indicators */
+    uint16_t toggles_sent;
+    uint16_t toggles_seen;
+    struct k_work_delayable work;
+} cal;
 
-    bool changed = false;
+static uint16_t cal_scale(uint16_t ms, uint8_t pct) {
+    uint32_t v = (uint32_t)ms * pct / 100;
+    return v ? (uint16_t)v : 1;
+}
 
-    if (pending_hold) {
-        pending_hold = false;
-        do_hold_action();
-        request_diff_render();
-        /* hold consumes action; still allow other queued inputs next cycle */
-        return;
+static void cal_apply_level(void) {
+    uint8_t pct = cal_levels_pct[cal.level];
+    draw_delay.char_ms = cal_scale(cal.base.char_ms, pct);
+    draw_delay.enter_ms = cal_scale(cal.base.enter_ms, pct);
+    draw_delay.nav_ms = cal_scale(cal.base.nav_ms, pct);
+    draw_delay.action_ms = cal_scale(cal.base.action_ms, pct);
+}
+
+static void cal_start_run(void) {
+    struct render_plan p = { .buf = rs.plan, .cap = RENDER_PLAN_MAX };
+    int n = (int)sizeof(cal_pattern) - 1;
+
+    plan_op(&p, OP_DOC_END);
+    for (int i = 0; i < n; i++) {
+        plan_type(&p, &cal_pattern[i], 1);
+        plan_op(&p, OP_LOCK_TOGGLE);
     }
+    plan_op(&p, OP_SHIFT_PRESS);
+    plan_op(&p, OP_HOME);
+    plan_op(&p, OP_SHIFT_RELEASE);
+    plan_op_n(&p, OP_BACKSPACE, 1);
+
+    cal.toggles_sent = (uint16_t)n;
+    cal.toggles_seen = 0;
+    cal.leds = zmk_hid_indicators_get_current_profile();
+    start_plan(p.len, PLAN_DONE_CALIBRATE);
+}
 
-    /* dx */
-    if (pending_dx != 0) {
-        int dx = pending_dx;
-        pending_dx = 0;
+static void cal_save(void) {
+#if IS_ENABLED(CONFIG_SETTINGS)
+    int rc = settings_save_one("tetris/delays", &draw_delay, sizeof(draw_delay));
+    if (rc) LOG_WRN("tetris: saving calibrated delays failed (%d)", rc);
+#endif
+}
 
-        int nx = falling.x + dx;
-        if (can_place(falling.type, falling.rot, nx, falling.y)) {
-            falling.x = nx;
-            changed = true;
-        }
+/* leave calibration mode; the game resumes where it was */
+static void cal_end(void) {
+    k_work_cancel_delayable(&cal.work);
+    cal.active = false;
+    game_set_paused(cal.was_paused);
+}
+
+static void cal_finish(void) {
+    draw_delay = cal.good;
+    if (cal.found) {
+        LOG_INF("tetris: calibrated delays char=%u enter=%u nav=%u action=%u",
+                draw_delay.char_ms, draw_delay.enter_ms, draw_delay.nav_ms, draw_delay.action_ms);
+        cal_save();
+    } else {
+        LOG_WRN("tetris: calibration failed at the current delays, keeping them");
     }
 
-    /* rotate: CCW then CW */
-    while (pending_rot_ccw > 0) {
-        pending_rot_ccw--;
-        if (try_rotate(-1)) changed = true;
+    bool dirty = cal.dirty;
+    cal_end();
+    if (dirty) {
+        /* leftovers on the last line: wipe and retype everything */
+        invalidate_render_model();
+        start_full_redraw();
+    } else {
+        request_diff_render();
     }
-    while (pending_rot_cw > 0) {
-        pending_rot_cw--;
-        if (try_rotate(+1)) changed = true;
+}
+
+static void cal_work_handler(struct k_work *work) {
+    ARG_UNUSED(work);
+    if (!cal.active || rs.running) return;
+
+    if (cal.toggles_seen != cal.toggles_sent) {
+        cal.dirty = true;
+        cal_finish();
+        return;
     }
 
-    /* hard drop overrides */
-    if (pending_hard_drop) {
-        pending_hard_drop = false;
-        last_land_was_harddrop = true;
-        hard_drop_and_land();
+    if (++cal.run < CAL_RUNS) {
+        cal_start_run();
         return;
     }
 
-    /* soft drop */
-    if (pending_soft_drop > 0) {
-        int n = pending_soft_drop;
-        pending_soft_drop = 0;
-        for (int i = 0; i < n; i++) {
-            if (do_fall_one()) {
-                changed = true;
-            } else {
-                last_land_was_harddrop = false;
-                on_piece_landed();
-                return;
-            }
-        }
-        changed = true;
+    cal.good = draw_delay;
+    cal.found = true;
+    cal.run = 0;
+    if (++cal.level >= ARRAY_SIZE(cal_levels_pct)) {
+        cal_finish();
+        return;
+    }
+    cal_apply_level();
+    cal_start_run();
+}
+
+static void calib_run_done(void) {
+    cursor_set(LAST_LINE_INDEX, 0);
+    k_work_reschedule(&cal.work, K_MSEC(CAL_SETTLE_MS));
+}
+
+static void calib_on_leds(uint8_t leds) {
+    if (!cal.active) return;
+
+    if ((leds ^ cal.leds) & LED_SCROLL_LOCK) cal.toggles_seen++;
+    cal.leds = leds;
+    if (!rs.running && cal.toggles_seen == cal.toggles_sent) {
+        k_work_reschedule(&cal.work, K_NO_WAIT);
+    }
+}
+
+static inline bool calib_active(void) { return cal.active; }
+
+static void calib_start(void) {
+    if (cal.active) return;
+
+    if (rs.running) {
+        stop_render();
+        invalidate_render_model();
     }
 
-    if (changed) request_diff_render();
+    cal.active = true;
+    cal.was_paused = paused;
+    game_set_paused(true);
+
+    cal.base = cal.good = draw_delay;
+    cal.found = false;
+    cal.dirty = false;
+    cal.level = 0;
+    cal.run = 0;
+    cal_start_run();
+}
+
+/* abort, back to the delays from before; the last line may hold a partial run */
+static void calib_cancel(void) {
+    if (!cal.active) return;
+
+    stop_render();
+    draw_delay = cal.base;
+    cal_end();
+    invalidate_render_model();
+    start_full_redraw();
+}
+
+#if IS_ENABLED(CONFIG_SETTINGS)
+static int tetris_settings_set(const char *name, size_t len, settings_read_cb read_cb, void *cb_arg) {
+    if (!settings_name_steq(name, "delays", NULL)) return -ENOENT;
+    if (len != sizeof(struct draw_delays)) return -EINVAL;
+
+    struct draw_delays d;
+    int rc = read_cb(cb_arg, &d, sizeof(d));
+    if (rc < 0) return rc;
+    if (!d.char_ms || !d.enter_ms || !d.nav_ms || !d.action_ms) return -EINVAL;
+
+    draw_delay = d;
+    return 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(tetris, "tetris", NULL, tetris_settings_set, NULL, NULL);
+#endif
+#else
+static inline void calib_run_done(void) {}
+static inline void calib_on_leds(uint8_t leds) { ARG_UNUSED(leds); }
+static inline bool calib_active(void) { return false; }
+static inline void calib_cancel(void) {}
+#endif
+
+#if TETRIS_LED_ACK
+static int tetris_indicators_listener(const zmk_event_t *eh) {
+    const struct zmk_hid_indicators_changed *ev = as_zmk_hid_indicators_changed(eh);
+    if (ev == NULL) return ZMK_EV_EVENT_BUBBLE;
+
+    flow_on_leds(ev->indicators);
+    calib_on_leds(ev->indicators);
+    return ZMK_EV_EVENT_BUBBLE;
 }
 
+ZMK_LISTENER(behavior_tetris, tetris_indicators_listener);
+ZMK_SUBSCRIPTION(behavior_tetris, zmk_hid_indicators_changed);
+#endif
+
+/* ==============================
+ * Input handling
+ *
+ * Moves change the game at once, also while the renderer is typing; it
+ * picks up whatever changed when its plan is done, so intermediate states
+ * are never typed. Moves without a piece to act on (clear animation, spawn
+ * delay) are held in press order and replayed when the next piece spawns.
+ * ============================== */
+#define HELD_MOVES_MAX 16   /* moves pressed during one clear or spawn delay */
+
+static struct {
+    uint8_t cmd[HELD_MOVES_MAX];
+    uint8_t len;
+} held_moves;
+
 static void on_user_dx(int dx) {
     if (paused) return;
     on_user_input_common();
-    if (rs.running || clearing || !has_falling) { pending_dx += dx; return; }
 
     int nx = falling.x + dx;
     if (can_place(falling.type, falling.rot, nx, falling.y)) {
-        falling.x = nx;
+        move_falling(nx, falling.y, falling.rot);
         request_diff_render();
     }
 }
 
 static void on_user_rotate(int dir) {
     on_user_input_common();
-    if (rs.running || clearing || !has_falling) {
-        if (dir > 0) pending_rot_cw++;
-        else pending_rot_ccw++;
-        return;
-    }
     if (try_rotate(dir)) request_diff_render();
 }
 
 static void on_user_soft_drop(void) {
     on_user_input_common();
-    if (rs.running || clearing || !has_falling) { pending_soft_drop++; return; }
 
     if (do_fall_one()) {
         request_diff_render();
@@ -1199,48 +3074,69 @@ static void on_user_soft_drop(void) {
 
 static void on_user_hard_drop(void) {
     on_user_input_common();
-    if (rs.running || clearing || !has_falling) { pending_hard_drop = true; return; }
     last_land_was_harddrop = true;
     hard_drop_and_land();
 }
 
 static void on_user_hold(void) {
     on_user_input_common();
-    if (rs.running || clearing || !has_falling) { pending_hold = true; return; }
     do_hold_action();
     request_diff_render();
 }
 
+/* cmd 10..16 */
+static void run_move(uint8_t cmd) {
+    if (clearing || !has_falling) {
+        on_user_input_common();
+        if (held_moves.len < HELD_MOVES_MAX) held_moves.cmd[held_moves.len++] = cmd;
+        return;
+    }
+
+    switch (cmd) {
+    case 10: on_user_dx(-1); break;
+    case 11: on_user_dx(+1); break;
+    case 12: on_user_rotate(+1); break;
+    case 13: on_user_soft_drop(); break;
+    case 14: on_user_rotate(-1); break;
+    case 15: on_user_hard_drop(); break;
+    case 16: on_user_hold(); break;
+    default: break;
+    }
+}
+
+/* a piece spawned: replay held moves until one of them lands it */
+static void replay_held_moves(void) {
+    uint8_t i = 0;
+    while (i < held_moves.len && has_falling && !clearing) run_move(held_moves.cmd[i++]);
+
+    uint8_t w = 0;
+    while (i < held_moves.len) held_moves.cmd[w++] = held_moves.cmd[i++];
+    held_moves.len = w;
+}
+
 /* ==============================
  * Init/reset
  * ============================== */
 static void reset_game(void) {
     paused = false;
-    for (int r = 0; r < BOARD_H; r++) {
-        for (int c = 0; c < BOARD_W; c++) board_locked[r][c] = 0;
-        for (int i = 0; i < BOARD_W + 2; i++) render_prev[r][i] = '\0';
-    }
+    board_wipe();
 
     /* score */
     score = 0;
     lines_cleared_total = 0;
-    score_prev[0] = '\0';
 
     /* bag + hold */
     refill_and_shuffle_bag();
     hold_type = -1;
     hold_used = false;
 
-    pending_dx = 0;
-    pending_rot_cw = 0;
-    pending_rot_ccw = 0;
-    pending_soft_drop = 0;
-    pending_hard_drop = false;
-    pending_hold = false;
+    held_moves.len = 0;
 
     clearing = false;
     clear_mask = 0;
     clear_step = 0;
+    clear_waits_render = false;
+    rows_dirty = ROWS_ALL;
 
     last_land_was_harddrop = false;
     pending_spawn_delay_ms = 0;
@@ -1249,115 +3145,150 @@ static void reset_game(void) {
 
     spawn_piece();
     has_falling = true;
-
-    rebuild_render_next();
-    for (int r = 0; r < BOARD_H; r++)
-        for (int i = 0; i < BOARD_W + 2; i++)
-            render_prev[r][i] = '\0';
 }
 
 /* ==============================
- * Behavior entry
+ * Command queue
  *
- * Commands:
- * 0: reset + async clear + async draw + start gravity (idle)
- * 1: async clear editor
- * 2: pause toggle
- * 3: redraw (score+board) without clearing editor
- * 10: left
- * 11: right
- * 12: rotate CW
- * 13: soft drop
- * 14: rotate CCW
- * 15: hard drop
- * 16: HOLD (keep)
+ * on_pressed runs in the event context; gravity, clears, spawns and the
+ * renderer run in the system workqueue. Commands cross over through a
+ * single-producer/single-consumer ring: on_pressed only advances head,
+ * input_work only tail, so neither side takes a lock. input_work runs the
+ * commands in press order and is the only place they touch the game.
  * ============================== */
-static int on_pressed(struct zmk_behavior_binding *binding,
-                      struct zmk_behavior_binding_event event) {
-    ARG_UNUSED(event);
+#define INPUT_QUEUE_MAX 16
+BUILD_ASSERT((INPUT_QUEUE_MAX & (INPUT_QUEUE_MAX - 1)) == 0, "command ring indexes by mask");
 
-    uint32_t cmd = binding->param1;
+static struct {
+    uint8_t cmd[INPUT_QUEUE_MAX];
+    atomic_t head;  /* next slot to write, on_pressed */
+    atomic_t tail;  /* next slot to read, input_work */
+} cmdq;
 
-    if (!rs.inited) {
-        k_work_init_delayable(&rs.work, render_work_handler);
-        k_work_init_delayable(&gravity_work, gravity_work_handler);
-        k_work_init_delayable(&clear_work, clear_work_handler);
-        k_work_init_delayable(&spawn_work, spawn_work_handler);
-        rs.inited = true;
-    }
+static struct k_work input_work;
+
+static bool cmdq_push(uint8_t cmd) {
+    uint32_t head = (uint32_t)atomic_get(&cmdq.head);
+    if (head - (uint32_t)atomic_get(&cmdq.tail) >= INPUT_QUEUE_MAX) return false;
 
+    cmdq.cmd[head & (INPUT_QUEUE_MAX - 1)] = cmd;
+    atomic_set(&cmdq.head, (atomic_val_t)(head + 1)); /* publishes the slot */
+    return true;
+}
+
+static bool cmdq_pop(uint8_t *cmd) {
+    uint32_t tail = (uint32_t)atomic_get(&cmdq.tail);
+    if (tail == (uint32_t)atomic_get(&cmdq.head)) return false;
+
+    *cmd = cmdq.cmd[tail & (INPUT_QUEUE_MAX - 1)];
+    atomic_set(&cmdq.tail, (atomic_val_t)(tail + 1)); /* frees the slot */
+    return true;
+}
+
+static void run_command(uint8_t cmd) {
     LOG_DBG("tetris cmd=%d", cmd);
 
+    /* the game is held while calibrating; control commands abort it */
+    if (calib_active()) {
+        if (cmd >= 10) return;
+        if (cmd <= 3) calib_cancel();
+    }
+
     switch (cmd) {
-    case 0:
-        stop_render();
-        k_work_cancel_delayable(&gravity_work);
-        k_work_cancel_delayable(&clear_work);
-        k_work_cancel_delayable(&spawn_work);
+    case 0: {
+        /* a cancelled diff costs at most the line it was typing */
+        bool diffable = stop_render() && render_layout_known();
+
+        game_timers_stop();
 
         reset_game();
-        build_full_frame_text();
-        start_clear_editor_async(REQ_RESET_AND_DRAW);
+        if (diffable) {
+            /* cost model picks diff or wipe + full retype */
+            request_diff_render();
+        } else {
+            invalidate_render_model();
+            start_full_redraw();
+        }
 
         schedule_gravity_idle();
-        return ZMK_BEHAVIOR_OPAQUE;
+        break;
+    }
 
     case 1:
         stop_render();
-        k_work_cancel_delayable(&gravity_work);
-        k_work_cancel_delayable(&clear_work);
-        k_work_cancel_delayable(&spawn_work);
+        game_timers_stop();
+
+        invalidate_render_model();
+        start_clear_only();
+        break;
 
-        start_clear_editor_async(REQ_CLEAR_ONLY);
-        return ZMK_BEHAVIOR_OPAQUE;
-    
     case 2: /* pause toggle */
-        paused = !paused;
-        if (paused) {
-            /* stop game progression immediately */
-            k_work_cancel_delayable(&gravity_work);
-        } else {
-            /* resume */
-            schedule_gravity_idle();
-        }
-        /* 表示を変えないなら不要だが、状態ズレ対策で再描画はしておくと安心 */
-        force_redraw_all();
-        return ZMK_BEHAVIOR_OPAQUE;
+        game_set_paused(!paused);
+        /* pausing changes no text; just flush whatever is dirty */
+        request_diff_render();
+        break;
 
     case 3: /* redraw */
         force_redraw_all();
-        return ZMK_BEHAVIOR_OPAQUE;
-    case 10:
-        on_user_dx(-1);
-        return ZMK_BEHAVIOR_OPAQUE;
+        break;
 
-    case 11:
-        on_user_dx(+1);
-        return ZMK_BEHAVIOR_OPAQUE;
+#if IS_ENABLED(CONFIG_ZMK_TETRIS_CALIBRATION)
+    case 4:
+        calib_start();
+        break;
+#endif
 
-    case 12:
-        on_user_rotate(+1);
-        return ZMK_BEHAVIOR_OPAQUE;
+    default:
+        run_move(cmd);
+        break;
+    }
+}
 
-    case 13:
-        on_user_soft_drop();
-        return ZMK_BEHAVIOR_OPAQUE;
+static void input_work_handler(struct k_work *work) {
+    ARG_UNUSED(work);
 
-    case 14:
-        on_user_rotate(-1);
-        return ZMK_BEHAVIOR_OPAQUE;
+    uint8_t cmd;
+    while (cmdq_pop(&cmd)) run_command(cmd);
+}
 
-    case 15:
-        on_user_hard_drop();
-        return ZMK_BEHAVIOR_OPAQUE;
+/* ==============================
+ * Behavior entry
+ *
+ * Commands:
+ * 0: reset + async clear + async draw + start gravity (idle)
+ * 1: async clear editor
+ * 2: pause toggle
+ * 3: redraw (score+board) without clearing editor
+ * 4: calibrate draw delays (CONFIG_ZMK_TETRIS_CALIBRATION)
+ * 10: left
+ * 11: right
+ * 12: rotate CW
+ * 13: soft drop
+ * 14: rotate CCW
+ * 15: hard drop
+ * 16: HOLD (keep)
+ * ============================== */
+static bool cmd_known(uint32_t cmd) {
+#if IS_ENABLED(CONFIG_ZMK_TETRIS_CALIBRATION)
+    if (cmd == 4) return true;
+#endif
+    return cmd <= 3 || (cmd >= 10 && cmd <= 16);
+}
 
-    case 16:
-        on_user_hold();
-        return ZMK_BEHAVIOR_OPAQUE;
+static int on_pressed(struct zmk_behavior_binding *binding,
+                      struct zmk_behavior_binding_event event) {
+    ARG_UNUSED(event);
 
-    default:
-        return ZMK_BEHAVIOR_TRANSPARENT;
+    uint32_t cmd = binding->param1;
+
+    if (!cmd_known(cmd)) return ZMK_BEHAVIOR_TRANSPARENT;
+
+    if (!cmdq_push((uint8_t)cmd)) {
+        LOG_WRN("tetris: command queue full, dropping cmd=%d", cmd);
+        return ZMK_BEHAVIOR_OPAQUE;
     }
+    k_work_submit(&input_work);
+    return ZMK_BEHAVIOR_OPAQUE;
 }
 
 static const struct behavior_driver_api api = {
@@ -1365,8 +3296,42 @@ static const struct behavior_driver_api api = {
     .binding_released = NULL,
 };
 
+struct behavior_tetris_config {
+    uint16_t idle_before_fall_ms;
+    uint16_t fall_interval_ms;
+    struct draw_delays delays;
+};
+
+/* The game is global; the last instance's props win. Calibrated delays are
+ * loaded from settings after this and override the DT ones. */
+static int behavior_tetris_init(const struct device *dev) {
+    const struct behavior_tetris_config *cfg = dev->config;
+
+    idle_before_fall_ms = cfg->idle_before_fall_ms;
+    fall_interval_ms = cfg->fall_interval_ms;
+    draw_delay = cfg->delays;
+
+    k_work_init_delayable(&rs.work, render_work_handler);
+    k_work_init_delayable(&game_work, game_work_handler);
+    k_work_init(&input_work, input_work_handler);
+#if IS_ENABLED(CONFIG_ZMK_TETRIS_CALIBRATION)
+    k_work_init_delayable(&cal.work, cal_work_handler);
+#endif
+    return 0;
+}
+
 #define INST(n) \
-    BEHAVIOR_DT_INST_DEFINE(n, NULL, NULL, NULL, NULL, \
+    static const struct behavior_tetris_config behavior_tetris_config_##n = { \
+        .idle_before_fall_ms = DT_INST_PROP(n, idle_before_fall_ms), \
+        .fall_interval_ms = DT_INST_PROP(n, fall_interval_ms), \
+        .delays = { \
+            .char_ms = DT_INST_PROP(n, draw_delay_char_ms), \
+            .enter_ms = DT_INST_PROP(n, draw_delay_enter_ms), \
+            .nav_ms = DT_INST_PROP(n, draw_delay_nav_ms), \
+            .action_ms = DT_INST_PROP(n, draw_delay_action_ms), \
+        }, \
+    }; \
+    BEHAVIOR_DT_INST_DEFINE(n, behavior_tetris_init, NULL, NULL, &behavior_tetris_config_##n, \
         POST_KERNEL, CONFIG_KERNEL_INIT_PRIORITY_DEFAULT, &api);
 
 DT_INST_FOREACH_STATUS_OKAY(INST)
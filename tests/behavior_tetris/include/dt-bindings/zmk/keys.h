@@ -0,0 +1,86 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+/* Stand-in for ZMK's dt-bindings/zmk/keys.h: the keys the behavior sends,
+ * with ZMK's encoding (modifier flags in the top byte). */
+
+#define HID_USAGE_KEY 0x07
+
+#define ZMK_HID_USAGE(page, id) (((page) << 16) | (id))
+#define ZMK_HID_USAGE_ID(usage) ((usage) & 0xFFFF)
+#define ZMK_HID_USAGE_PAGE(usage) (((usage) >> 16) & 0xFF)
+
+#define MOD_LCTL 0x01
+#define MOD_LSFT 0x02
+#define MOD_LALT 0x04
+#define MOD_LGUI 0x08
+#define MOD_RCTL 0x10
+#define MOD_RSFT 0x20
+#define MOD_RALT 0x40
+#define MOD_RGUI 0x80
+
+#define APPLY_MODS(mods, keycode) (((mods) << 24) | (keycode))
+#define SELECT_MODS(keycode) (((keycode) >> 24) & 0xFF)
+#define STRIP_MODS(keycode) ((keycode) & ~(0xFF << 24))
+
+#define LC(keycode) APPLY_MODS(MOD_LCTL, keycode)
+#define LS(keycode) APPLY_MODS(MOD_LSFT, keycode)
+#define LA(keycode) APPLY_MODS(MOD_LALT, keycode)
+
+#define A ZMK_HID_USAGE(HID_USAGE_KEY, 0x04)
+#define B ZMK_HID_USAGE(HID_USAGE_KEY, 0x05)
+#define C ZMK_HID_USAGE(HID_USAGE_KEY, 0x06)
+#define D ZMK_HID_USAGE(HID_USAGE_KEY, 0x07)
+#define E ZMK_HID_USAGE(HID_USAGE_KEY, 0x08)
+#define F ZMK_HID_USAGE(HID_USAGE_KEY, 0x09)
+#define G ZMK_HID_USAGE(HID_USAGE_KEY, 0x0A)
+#define H ZMK_HID_USAGE(HID_USAGE_KEY, 0x0B)
+#define I ZMK_HID_USAGE(HID_USAGE_KEY, 0x0C)
+#define J ZMK_HID_USAGE(HID_USAGE_KEY, 0x0D)
+#define K ZMK_HID_USAGE(HID_USAGE_KEY, 0x0E)
+#define L ZMK_HID_USAGE(HID_USAGE_KEY, 0x0F)
+#define M ZMK_HID_USAGE(HID_USAGE_KEY, 0x10)
+#define N ZMK_HID_USAGE(HID_USAGE_KEY, 0x11)
+#define O ZMK_HID_USAGE(HID_USAGE_KEY, 0x12)
+#define P ZMK_HID_USAGE(HID_USAGE_KEY, 0x13)
+#define Q ZMK_HID_USAGE(HID_USAGE_KEY, 0x14)
+#define R ZMK_HID_USAGE(HID_USAGE_KEY, 0x15)
+#define S ZMK_HID_USAGE(HID_USAGE_KEY, 0x16)
+#define T ZMK_HID_USAGE(HID_USAGE_KEY, 0x17)
+#define U ZMK_HID_USAGE(HID_USAGE_KEY, 0x18)
+#define V ZMK_HID_USAGE(HID_USAGE_KEY, 0x19)
+#define W ZMK_HID_USAGE(HID_USAGE_KEY, 0x1A)
+#define X ZMK_HID_USAGE(HID_USAGE_KEY, 0x1B)
+#define Y ZMK_HID_USAGE(HID_USAGE_KEY, 0x1C)
+#define Z ZMK_HID_USAGE(HID_USAGE_KEY, 0x1D)
+#define N1 ZMK_HID_USAGE(HID_USAGE_KEY, 0x1E)
+#define N2 ZMK_HID_USAGE(HID_USAGE_KEY, 0x1F)
+#define N3 ZMK_HID_USAGE(HID_USAGE_KEY, 0x20)
+#define N4 ZMK_HID_USAGE(HID_USAGE_KEY, 0x21)
+#define N5 ZMK_HID_USAGE(HID_USAGE_KEY, 0x22)
+#define N6 ZMK_HID_USAGE(HID_USAGE_KEY, 0x23)
+#define N7 ZMK_HID_USAGE(HID_USAGE_KEY, 0x24)
+#define N8 ZMK_HID_USAGE(HID_USAGE_KEY, 0x25)
+#define N9 ZMK_HID_USAGE(HID_USAGE_KEY, 0x26)
+#define N0 ZMK_HID_USAGE(HID_USAGE_KEY, 0x27)
+#define ENTER ZMK_HID_USAGE(HID_USAGE_KEY, 0x28)
+#define ESCAPE ZMK_HID_USAGE(HID_USAGE_KEY, 0x29)
+#define BACKSPACE ZMK_HID_USAGE(HID_USAGE_KEY, 0x2A)
+#define SPACE ZMK_HID_USAGE(HID_USAGE_KEY, 0x2C)
+#define MINUS ZMK_HID_USAGE(HID_USAGE_KEY, 0x2D)
+#define UNDER (LS(MINUS))
+#define DOT ZMK_HID_USAGE(HID_USAGE_KEY, 0x37)
+#define SCROLLLOCK ZMK_HID_USAGE(HID_USAGE_KEY, 0x47)
+#define HOME ZMK_HID_USAGE(HID_USAGE_KEY, 0x4A)
+#define DELETE ZMK_HID_USAGE(HID_USAGE_KEY, 0x4C)
+#define END ZMK_HID_USAGE(HID_USAGE_KEY, 0x4D)
+#define RIGHT ZMK_HID_USAGE(HID_USAGE_KEY, 0x4F)
+#define LEFT ZMK_HID_USAGE(HID_USAGE_KEY, 0x50)
+#define DOWN ZMK_HID_USAGE(HID_USAGE_KEY, 0x51)
+#define UP ZMK_HID_USAGE(HID_USAGE_KEY, 0x52)
+#define LCTRL ZMK_HID_USAGE(HID_USAGE_KEY, 0xE0)
+#define LSHIFT ZMK_HID_USAGE(HID_USAGE_KEY, 0xE1)
+#define LALT ZMK_HID_USAGE(HID_USAGE_KEY, 0xE2)
+#define RGUI ZMK_HID_USAGE(HID_USAGE_KEY, 0xE7)
@@ -0,0 +1,23 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+/* Stand-in for ZMK's zmk/behavior.h: just what the behavior uses. */
+
+#include <stdint.h>
+
+#define ZMK_BEHAVIOR_OPAQUE 0
+#define ZMK_BEHAVIOR_TRANSPARENT 1
+
+struct zmk_behavior_binding {
+    const char *behavior_dev;
+    uint32_t param1;
+    uint32_t param2;
+};
+
+struct zmk_behavior_binding_event {
+    int layer;
+    uint32_t position;
+    int64_t timestamp;
+};
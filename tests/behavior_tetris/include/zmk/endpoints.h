@@ -0,0 +1,9 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include <stdint.h>
+
+/* Implemented by the test host: sends the current keyboard report. */
+int zmk_endpoints_send_report(uint16_t usage_page);
@@ -0,0 +1,24 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+/* Stand-in for ZMK's event manager: one listener per module, called by the
+ * test host directly instead of through the subscription list. */
+
+struct zmk_event_type {
+    const char *name;
+};
+
+typedef struct zmk_event_t {
+    const struct zmk_event_type *event;
+} zmk_event_t;
+
+#define ZMK_EV_EVENT_BUBBLE 0
+
+struct zmk_listener {
+    int (*callback)(const zmk_event_t *eh);
+};
+
+#define ZMK_LISTENER(mod, cb) const struct zmk_listener zmk_listener_##mod = {.callback = cb};
+#define ZMK_SUBSCRIPTION(mod, ev_type) extern const struct zmk_listener zmk_listener_##mod
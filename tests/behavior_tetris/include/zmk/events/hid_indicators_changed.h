@@ -0,0 +1,28 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include <zmk/event_manager.h>
+
+typedef uint8_t zmk_hid_indicators_t;
+
+struct zmk_hid_indicators_changed {
+    zmk_hid_indicators_t indicators;
+};
+
+struct zmk_hid_indicators_changed_event {
+    zmk_event_t header;
+    struct zmk_hid_indicators_changed data;
+};
+
+extern const struct zmk_event_type zmk_event_zmk_hid_indicators_changed;
+
+static inline struct zmk_hid_indicators_changed *
+as_zmk_hid_indicators_changed(const zmk_event_t *eh) {
+    return (eh->event == &zmk_event_zmk_hid_indicators_changed)
+               ? &((struct zmk_hid_indicators_changed_event *)eh)->data
+               : NULL;
+}
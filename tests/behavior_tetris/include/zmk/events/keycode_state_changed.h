@@ -0,0 +1,11 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Implemented by the test host: types the key into the editor model. */
+int raise_zmk_keycode_state_changed_from_encoded(uint32_t encoded, bool pressed,
+                                                 int64_t timestamp);
@@ -0,0 +1,13 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include <zmk/keys.h>
+
+/* Implemented by the test host: the keyboard report the direct HID path
+ * builds. */
+int zmk_hid_register_mods(zmk_mod_flags_t explicit_modifiers);
+int zmk_hid_unregister_mods(zmk_mod_flags_t explicit_modifiers);
+int zmk_hid_keyboard_press(zmk_key_t key);
+int zmk_hid_keyboard_release(zmk_key_t key);
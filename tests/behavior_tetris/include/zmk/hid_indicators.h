@@ -0,0 +1,9 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include <zmk/events/hid_indicators_changed.h>
+
+/* Implemented by the test host: the lock LEDs it reported last. */
+zmk_hid_indicators_t zmk_hid_indicators_get_current_profile(void);
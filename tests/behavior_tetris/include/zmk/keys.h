@@ -0,0 +1,18 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+/* Stand-in for ZMK's zmk/keys.h. */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <dt-bindings/zmk/keys.h>
+
+typedef uint32_t zmk_key_t;
+typedef uint8_t zmk_mod_flags_t;
+
+static inline bool is_mod(uint8_t usage_page, uint32_t keycode) {
+    return usage_page == HID_USAGE_KEY && keycode >= 0xE0 && keycode <= 0xE7;
+}
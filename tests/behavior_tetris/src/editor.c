@@ -0,0 +1,589 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include <zephyr/sys/util.h>
+
+#include <dt-bindings/zmk/keys.h>
+
+#include "editor.h"
+
+#define ED_LINES_MAX   32
+#define ED_COLS_MAX    40
+#define ED_CURSORS_MAX 16
+#define ED_UNDO_MAX    32
+
+#define MODS_CTRL  (MOD_LCTL | MOD_RCTL)
+#define MODS_SHIFT (MOD_LSFT | MOD_RSFT)
+#define MODS_ALT   (MOD_LALT | MOD_RALT)
+
+struct cursor {
+    int l, c;       /* caret */
+    int al, ac;     /* selection anchor, == caret: no selection */
+    int want;       /* column kept across Up/Down */
+};
+
+struct ed_state {
+    char lines[ED_LINES_MAX][ED_COLS_MAX + 1];
+    int n_lines;
+    struct cursor cur[ED_CURSORS_MAX];
+    int n_cur;
+};
+
+/* what the last edit was: VS Code groups typing and deleting runs */
+enum edit_kind { EDIT_NONE = 0, EDIT_TYPE, EDIT_DEL, EDIT_LINE };
+
+static struct {
+    struct ed_state s;
+    struct ed_state undo[ED_UNDO_MAX];
+    int n_undo;
+    struct ed_state redo[ED_UNDO_MAX];
+    int n_redo;
+    enum edit_kind last_kind;
+    uint8_t mods;   /* modifier keys held */
+    int errors;
+    char first_error[64];
+} ed;
+
+static void ed_error(const char *what, uint32_t encoded) {
+    if (ed.errors++ == 0) {
+        snprintf(ed.first_error, sizeof(ed.first_error), "%s 0x%08x", what, (unsigned)encoded);
+    }
+}
+
+/* ==============================
+ * Cursors
+ * ============================== */
+static int pos_cmp(int l1, int c1, int l2, int c2) {
+    if (l1 != l2) return l1 < l2 ? -1 : 1;
+    if (c1 != c2) return c1 < c2 ? -1 : 1;
+    return 0;
+}
+
+static bool cur_sel(const struct cursor *k) { return k->l != k->al || k->c != k->ac; }
+
+static void cur_set(struct cursor *k, int l, int c, bool extend, bool keep_want) {
+    k->l = l;
+    k->c = c;
+    if (!keep_want) k->want = c;
+    if (!extend) {
+        k->al = l;
+        k->ac = c;
+    }
+}
+
+static struct cursor cur_at(int l, int c) {
+    struct cursor k = { .l = l, .c = c, .al = l, .ac = c, .want = c };
+    return k;
+}
+
+/* selection start/end in document order */
+static void cur_range(const struct cursor *k, int *l1, int *c1, int *l2, int *c2) {
+    if (pos_cmp(k->al, k->ac, k->l, k->c) <= 0) {
+        *l1 = k->al; *c1 = k->ac; *l2 = k->l; *c2 = k->c;
+    } else {
+        *l1 = k->l; *c1 = k->c; *l2 = k->al; *c2 = k->ac;
+    }
+}
+
+static int line_len(int l) { return (int)strlen(ed.s.lines[l]); }
+
+/* other cursors after the range (l1,c1)-(l2,c2) was deleted */
+static void fix_after_delete(const struct cursor *who, int l1, int c1, int l2, int c2) {
+    for (int i = 0; i < ed.s.n_cur; i++) {
+        struct cursor *o = &ed.s.cur[i];
+        if (o == who) continue;
+        int *pl[2] = { &o->l, &o->al }, *pc[2] = { &o->c, &o->ac };
+        for (int k = 0; k < 2; k++) {
+            int ln = *pl[k], col = *pc[k];
+            if (pos_cmp(ln, col, l1, c1) <= 0) continue;
+            if (pos_cmp(ln, col, l2, c2) <= 0) {
+                ln = l1; col = c1;
+            } else if (ln == l2) {
+                ln = l1; col = c1 + (col - c2);
+            } else {
+                ln -= l2 - l1;
+            }
+            *pl[k] = ln;
+            *pc[k] = col;
+        }
+    }
+}
+
+/* other cursors after text was inserted at (l,c): `nl` line breaks, the
+ * last inserted line `last_len` long */
+static void fix_after_insert(const struct cursor *who, int l, int c, int nl, int last_len) {
+    for (int i = 0; i < ed.s.n_cur; i++) {
+        struct cursor *o = &ed.s.cur[i];
+        if (o == who) continue;
+        int *pl[2] = { &o->l, &o->al }, *pc[2] = { &o->c, &o->ac };
+        for (int k = 0; k < 2; k++) {
+            int ln = *pl[k], col = *pc[k];
+            if (pos_cmp(ln, col, l, c) < 0) continue;
+            if (ln == l) {
+                col = nl ? col - c + last_len : col + last_len;
+                ln = l + nl;
+            } else {
+                ln += nl;
+            }
+            *pl[k] = ln;
+            *pc[k] = col;
+        }
+    }
+}
+
+/* VS Code merges cursors that end up on the same spot */
+static void merge_cursors(void) {
+    int n = 0;
+    for (int i = 0; i < ed.s.n_cur; i++) {
+        bool dup = false;
+        for (int j = 0; j < n; j++) {
+            if (ed.s.cur[j].l == ed.s.cur[i].l && ed.s.cur[j].c == ed.s.cur[i].c) dup = true;
+        }
+        if (!dup) ed.s.cur[n++] = ed.s.cur[i];
+    }
+    ed.s.n_cur = n;
+}
+
+/* ==============================
+ * Text edits
+ * ============================== */
+static void remove_lines(int from, int n) {
+    if (n <= 0) return;
+    memmove(ed.s.lines[from], ed.s.lines[from + n],
+            (size_t)(ed.s.n_lines - from - n) * sizeof(ed.s.lines[0]));
+    ed.s.n_lines -= n;
+}
+
+static bool open_line(int at) {
+    if (ed.s.n_lines >= ED_LINES_MAX) return false;
+    memmove(ed.s.lines[at + 1], ed.s.lines[at],
+            (size_t)(ed.s.n_lines - at) * sizeof(ed.s.lines[0]));
+    ed.s.n_lines++;
+    ed.s.lines[at][0] = '\0';
+    return true;
+}
+
+static void delete_selection(struct cursor *k) {
+    if (!cur_sel(k)) return;
+
+    int l1, c1, l2, c2;
+    cur_range(k, &l1, &c1, &l2, &c2);
+    char tail[ED_COLS_MAX + 1];
+    strcpy(tail, &ed.s.lines[l2][c2]);
+    ed.s.lines[l1][c1] = '\0';
+    strcat(ed.s.lines[l1], tail);
+    remove_lines(l1 + 1, l2 - l1);
+    fix_after_delete(k, l1, c1, l2, c2);
+    cur_set(k, l1, c1, false, false);
+}
+
+static void insert_char(struct cursor *k, char ch) {
+    delete_selection(k);
+
+    char *line = ed.s.lines[k->l];
+    int len = (int)strlen(line);
+    if (len >= ED_COLS_MAX) {
+        ed_error("line overflow", (uint32_t)k->l);
+        return;
+    }
+    memmove(&line[k->c + 1], &line[k->c], (size_t)(len - k->c + 1));
+    line[k->c] = ch;
+    fix_after_insert(k, k->l, k->c, 0, 1);
+    cur_set(k, k->l, k->c + 1, false, false);
+}
+
+static void insert_newline(struct cursor *k) {
+    delete_selection(k);
+
+    if (!open_line(k->l + 1)) {
+        ed_error("too many lines", (uint32_t)k->l);
+        return;
+    }
+    strcpy(ed.s.lines[k->l + 1], &ed.s.lines[k->l][k->c]);
+    ed.s.lines[k->l][k->c] = '\0';
+    fix_after_insert(k, k->l, k->c, 1, 0);
+    cur_set(k, k->l + 1, 0, false, false);
+}
+
+/* ==============================
+ * Undo
+ * ============================== */
+static void stack_push(struct ed_state *stack, int *n) {
+    if (*n == ED_UNDO_MAX) {
+        memmove(&stack[0], &stack[1], (ED_UNDO_MAX - 1) * sizeof(stack[0]));
+        (*n)--;
+    }
+    stack[(*n)++] = ed.s;
+}
+
+/* a new undo stop, unless this edit continues a typing/deleting run */
+static void push_undo(enum edit_kind kind) {
+    ed.n_redo = 0;
+    if ((kind == EDIT_TYPE || kind == EDIT_DEL) && ed.last_kind == kind) return;
+    stack_push(ed.undo, &ed.n_undo);
+    ed.last_kind = kind;
+}
+
+/* ==============================
+ * Keys
+ * ============================== */
+static int char_class(char ch) {
+    if (ch == ' ' || ch == '\t') return 0;
+    if (strchr("`~!@#$%^&*()-=+[{]}\\|;:'\",.<>/?", ch)) return 1;
+    return 2;
+}
+
+static void word_right(int *l, int *c) {
+    const char *line = ed.s.lines[*l];
+    int len = (int)strlen(line);
+    if (*c >= len) {
+        if (*l + 1 < ed.s.n_lines) {
+            (*l)++;
+            *c = 0;
+        }
+        return;
+    }
+    while (*c < len && char_class(line[*c]) == 0) (*c)++;
+    if (*c < len) {
+        int k = char_class(line[*c]);
+        while (*c < len && char_class(line[*c]) == k) (*c)++;
+    }
+}
+
+static void word_left(int *l, int *c) {
+    const char *line = ed.s.lines[*l];
+    if (*c == 0) {
+        if (*l > 0) {
+            (*l)--;
+            *c = line_len(*l);
+        }
+        return;
+    }
+    while (*c > 0 && char_class(line[*c - 1]) == 0) (*c)--;
+    if (*c > 0) {
+        int k = char_class(line[*c - 1]);
+        while (*c > 0 && char_class(line[*c - 1]) == k) (*c)--;
+    }
+}
+
+static bool is_usage(uint32_t encoded, uint32_t key) {
+    return ZMK_HID_USAGE_ID(encoded) == ZMK_HID_USAGE_ID(key);
+}
+
+/* US keys, except the JIS layout the renderer targets: Shift+'-' is '=' */
+static char typed_char(uint32_t encoded, bool shift) {
+    uint32_t id = ZMK_HID_USAGE_ID(encoded);
+
+    if (id >= ZMK_HID_USAGE_ID(A) && id <= ZMK_HID_USAGE_ID(Z)) {
+        return (char)('a' + (id - ZMK_HID_USAGE_ID(A)));
+    }
+    if (id >= ZMK_HID_USAGE_ID(N1) && id <= ZMK_HID_USAGE_ID(N9)) {
+        return (char)('1' + (id - ZMK_HID_USAGE_ID(N1)));
+    }
+    if (is_usage(encoded, N0)) return '0';
+    if (is_usage(encoded, DOT)) return '.';
+    if (is_usage(encoded, SPACE)) return ' ';
+    if (is_usage(encoded, MINUS)) return shift ? '=' : '-';
+    return '\0';
+}
+
+static void key_nav(uint32_t encoded, bool ctrl, bool shift) {
+    ed.last_kind = EDIT_NONE;
+
+    for (int i = 0; i < ed.s.n_cur; i++) {
+        struct cursor *k = &ed.s.cur[i];
+
+        if (is_usage(encoded, HOME)) {
+            cur_set(k, ctrl ? 0 : k->l, 0, shift, false);
+        } else if (is_usage(encoded, END)) {
+            int l = ctrl ? ed.s.n_lines - 1 : k->l;
+            cur_set(k, l, line_len(l), shift, false);
+        } else if (is_usage(encoded, UP) || is_usage(encoded, DOWN)) {
+            int t = k->l + (is_usage(encoded, UP) ? -1 : 1);
+            if (t < 0) {
+                cur_set(k, 0, 0, shift, false);
+            } else if (t >= ed.s.n_lines) {
+                cur_set(k, k->l, line_len(k->l), shift, false);
+            } else {
+                int len = line_len(t);
+                cur_set(k, t, k->want < len ? k->want : len, shift, true);
+            }
+        } else if (is_usage(encoded, LEFT)) {
+            int l1, c1, l2, c2;
+            if (cur_sel(k) && !shift) {
+                cur_range(k, &l1, &c1, &l2, &c2);
+                cur_set(k, l1, c1, false, false);
+            } else if (ctrl) {
+                int l = k->l, c = k->c;
+                word_left(&l, &c);
+                cur_set(k, l, c, shift, false);
+            } else if (k->c > 0) {
+                cur_set(k, k->l, k->c - 1, shift, false);
+            } else if (k->l > 0) {
+                cur_set(k, k->l - 1, line_len(k->l - 1), shift, false);
+            }
+        } else {
+            int l1, c1, l2, c2;
+            if (cur_sel(k) && !shift) {
+                cur_range(k, &l1, &c1, &l2, &c2);
+                cur_set(k, l2, c2, false, false);
+            } else if (ctrl) {
+                int l = k->l, c = k->c;
+                word_right(&l, &c);
+                cur_set(k, l, c, shift, false);
+            } else if (k->c < line_len(k->l)) {
+                cur_set(k, k->l, k->c + 1, shift, false);
+            } else if (k->l + 1 < ed.s.n_lines) {
+                cur_set(k, k->l + 1, 0, shift, false);
+            }
+        }
+    }
+    merge_cursors();
+}
+
+/* Ctrl+Shift+K: the lines with a cursor go, one cursor stays */
+static void key_delete_lines(void) {
+    push_undo(EDIT_LINE);
+    ed.last_kind = EDIT_NONE;
+
+    int top = ED_LINES_MAX;
+    for (int l = ED_LINES_MAX - 1; l >= 0; l--) {
+        bool hit = false;
+        for (int i = 0; i < ed.s.n_cur; i++) hit |= (ed.s.cur[i].l == l);
+        if (!hit) continue;
+        if (ed.s.n_lines > 1) remove_lines(l, 1);
+        else ed.s.lines[0][0] = '\0';
+        top = l;
+    }
+    int l = top < ed.s.n_lines - 1 ? top : ed.s.n_lines - 1;
+    struct cursor *k = &ed.s.cur[0];
+    ed.s.n_cur = 1;
+    int len = line_len(l);
+    cur_set(k, l, k->want < len ? k->want : len, false, true);
+}
+
+/* Shift+Alt+Up/Down: copy the line, the cursor stays on the upper/lower copy */
+static void key_duplicate_line(bool down) {
+    push_undo(EDIT_LINE);
+    ed.last_kind = EDIT_NONE;
+
+    struct cursor *k = &ed.s.cur[0];
+    if (!open_line(k->l)) {
+        ed_error("too many lines", (uint32_t)k->l);
+        return;
+    }
+    strcpy(ed.s.lines[k->l], ed.s.lines[k->l + 1]);
+    if (down) {
+        k->l++;
+        k->al++;
+    }
+}
+
+/* Alt+Up/Down: swap each cursor's line with its neighbour */
+static void key_move_line(bool down) {
+    push_undo(EDIT_LINE);
+    ed.last_kind = EDIT_NONE;
+
+    int d = down ? 1 : -1;
+    for (int i = 0; i < ed.s.n_cur; i++) {
+        struct cursor *k = &ed.s.cur[i];
+        int t = k->l + d;
+        if (t < 0 || t >= ed.s.n_lines) continue;
+        char tmp[ED_COLS_MAX + 1];
+        strcpy(tmp, ed.s.lines[k->l]);
+        strcpy(ed.s.lines[k->l], ed.s.lines[t]);
+        strcpy(ed.s.lines[t], tmp);
+        k->l += d;
+        k->al += d;
+    }
+}
+
+/* Ctrl+Alt+Up/Down: one more cursor above the first / below the last */
+static void key_add_cursor(bool down) {
+    if (ed.s.n_cur >= ED_CURSORS_MAX) {
+        ed_error("too many cursors", 0);
+        return;
+    }
+    const struct cursor *base = down ? &ed.s.cur[ed.s.n_cur - 1] : &ed.s.cur[0];
+    int t = base->l + (down ? 1 : -1);
+    if (t < 0 || t >= ed.s.n_lines) return;
+
+    int len = line_len(t);
+    struct cursor k = cur_at(t, base->want < len ? base->want : len);
+    k.want = base->want;
+    if (down) {
+        ed.s.cur[ed.s.n_cur++] = k;
+    } else {
+        memmove(&ed.s.cur[1], &ed.s.cur[0], (size_t)ed.s.n_cur * sizeof(ed.s.cur[0]));
+        ed.s.cur[0] = k;
+        ed.s.n_cur++;
+    }
+}
+
+static void key_delete(bool forward) {
+    push_undo(EDIT_DEL);
+
+    for (int i = 0; i < ed.s.n_cur; i++) {
+        struct cursor *k = &ed.s.cur[i];
+        if (!cur_sel(k)) {
+            if (!forward) {
+                if (k->c > 0) {
+                    k->al = k->l;
+                    k->ac = k->c - 1;
+                } else if (k->l > 0) {
+                    k->al = k->l - 1;
+                    k->ac = line_len(k->l - 1);
+                }
+            } else {
+                if (k->c < line_len(k->l)) {
+                    k->al = k->l;
+                    k->ac = k->c + 1;
+                } else if (k->l + 1 < ed.s.n_lines) {
+                    k->al = k->l + 1;
+                    k->ac = 0;
+                }
+            }
+        }
+        delete_selection(k);
+    }
+}
+
+static void key_press(uint32_t encoded, uint8_t mods) {
+    bool ctrl = (mods & MODS_CTRL) != 0;
+    bool shift = (mods & MODS_SHIFT) != 0;
+    bool alt = (mods & MODS_ALT) != 0;
+    bool vertical = is_usage(encoded, UP) || is_usage(encoded, DOWN);
+    bool down = is_usage(encoded, DOWN);
+
+    /* lock keys are the host's business */
+    if (is_usage(encoded, SCROLLLOCK)) return;
+
+    if (is_usage(encoded, ESCAPE)) {
+        struct cursor *k = &ed.s.cur[0];
+        ed.s.n_cur = 1;
+        k->al = k->l;
+        k->ac = k->c;
+        return;
+    }
+
+    if (ctrl && !alt && !shift && is_usage(encoded, A)) {
+        int l = ed.s.n_lines - 1;
+        ed.s.cur[0] = cur_at(l, line_len(l));
+        ed.s.cur[0].al = 0;
+        ed.s.cur[0].ac = 0;
+        ed.s.n_cur = 1;
+        ed.last_kind = EDIT_NONE;
+        return;
+    }
+
+    if (ctrl && !alt && (is_usage(encoded, Z) || is_usage(encoded, Y))) {
+        if (is_usage(encoded, Z) && ed.n_undo > 0) {
+            stack_push(ed.redo, &ed.n_redo);
+            ed.s = ed.undo[--ed.n_undo];
+        } else if (is_usage(encoded, Y) && ed.n_redo > 0) {
+            stack_push(ed.undo, &ed.n_undo);
+            ed.s = ed.redo[--ed.n_redo];
+        }
+        ed.last_kind = EDIT_NONE;
+        return;
+    }
+
+    if (ctrl && shift && is_usage(encoded, K)) {
+        key_delete_lines();
+        return;
+    }
+
+    if (vertical && alt && shift && !ctrl) {
+        key_duplicate_line(down);
+        return;
+    }
+    if (vertical && alt && !shift && !ctrl) {
+        key_move_line(down);
+        return;
+    }
+    if (vertical && alt && ctrl) {
+        key_add_cursor(down);
+        return;
+    }
+
+    if (is_usage(encoded, HOME) || is_usage(encoded, END) || vertical ||
+        is_usage(encoded, LEFT) || is_usage(encoded, RIGHT)) {
+        key_nav(encoded, ctrl, shift);
+        return;
+    }
+
+    if (ctrl || alt) {
+        ed_error("unhandled chord", encoded | ((uint32_t)mods << 24));
+        return;
+    }
+
+    if (is_usage(encoded, BACKSPACE) || is_usage(encoded, DELETE)) {
+        key_delete(is_usage(encoded, DELETE));
+        return;
+    }
+
+    if (is_usage(encoded, ENTER)) {
+        push_undo(EDIT_TYPE);
+        for (int i = 0; i < ed.s.n_cur; i++) insert_newline(&ed.s.cur[i]);
+        return;
+    }
+
+    char ch = typed_char(encoded, shift);
+    if (ch == '\0') {
+        ed_error("unknown key", encoded);
+        return;
+    }
+    if (shift && !is_usage(encoded, MINUS)) ed_error("shifted char", encoded);
+
+    push_undo(EDIT_TYPE);
+    for (int i = 0; i < ed.s.n_cur; i++) insert_char(&ed.s.cur[i], ch);
+}
+
+/* ==============================
+ * API
+ * ============================== */
+void editor_reset(void) {
+    memset(&ed, 0, sizeof(ed));
+    ed.s.n_lines = 1;
+    ed.s.n_cur = 1;
+}
+
+void editor_key(uint32_t encoded, bool pressed) {
+    uint32_t id = ZMK_HID_USAGE_ID(encoded);
+
+    if (id >= ZMK_HID_USAGE_ID(LCTRL) && id <= ZMK_HID_USAGE_ID(RGUI)) {
+        uint8_t bit = (uint8_t)BIT(id - ZMK_HID_USAGE_ID(LCTRL));
+        if (pressed) ed.mods |= bit;
+        else ed.mods &= (uint8_t)~bit;
+        return;
+    }
+
+    /* implicit modifiers (LC(x) ...) only hold for their own key */
+    if (pressed) key_press(encoded, (uint8_t)(ed.mods | SELECT_MODS(encoded)));
+}
+
+bool editor_text(char *buf, size_t len) {
+    size_t n = 0;
+    for (int l = 0; l < ed.s.n_lines; l++) {
+        size_t ll = strlen(ed.s.lines[l]);
+        if (n + ll + 2 > len) return false;
+        memcpy(&buf[n], ed.s.lines[l], ll);
+        n += ll;
+        if (l + 1 < ed.s.n_lines) buf[n++] = '\n';
+    }
+    buf[n] = '\0';
+    return true;
+}
+
+const char *editor_line(int line) {
+    return (line >= 0 && line < ed.s.n_lines) ? ed.s.lines[line] : "";
+}
+
+int editor_line_count(void) { return ed.s.n_lines; }
+
+int editor_errors(void) { return ed.errors; }
+
+const char *editor_first_error(void) { return ed.first_error; }
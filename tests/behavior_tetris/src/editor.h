@@ -0,0 +1,26 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Model of the VS Code editor the behavior types into: the keys the
+ * renderer uses (navigation, word jumps, selection, Ctrl+Shift+K, line
+ * duplicate/move, column cursors, undo/redo with VS Code's grouping of
+ * consecutive typing), driven by ZMK encoded keycodes.
+ */
+void editor_reset(void);
+void editor_key(uint32_t encoded, bool pressed);
+
+/* the whole text, lines joined with '\n'; false if it did not fit */
+bool editor_text(char *buf, size_t len);
+const char *editor_line(int line);
+int editor_line_count(void);
+
+/* keys the model does not know, shifted characters, overflows */
+int editor_errors(void);
+const char *editor_first_error(void);
@@ -0,0 +1,289 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include <dt-bindings/zmk/keys.h>
+#include <zmk/endpoints.h>
+#include <zmk/events/keycode_state_changed.h>
+#include <zmk/hid.h>
+#include <zmk/hid_indicators.h>
+#include <tetris/hid_pacing.h>
+
+#include "editor.h"
+#include "host.h"
+
+LOG_MODULE_REGISTER(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+#define LED_SCROLL_LOCK BIT(2)
+
+static struct host_config cfg;
+static struct host_stats stats;
+
+/* ==============================
+ * HID transport
+ * ============================== */
+static struct k_work_delayable tx_work;
+static int tx_queued;
+
+static void tx_work_handler(struct k_work *work) {
+    ARG_UNUSED(work);
+
+    for (int i = 0; i < cfg.tx_per_interval && tx_queued > 0; i++) {
+        tx_queued--;
+#if IS_ENABLED(CONFIG_ZMK_TETRIS_HID_BACKPRESSURE)
+        if (cfg.tx_ack) zmk_tetris_hid_report_sent();
+#endif
+    }
+    if (tx_queued > 0) k_work_reschedule(&tx_work, K_MSEC(cfg.tx_interval_ms));
+}
+
+/* false: the report was lost */
+static bool tx_report(void) {
+    stats.reports++;
+    if (cfg.tx_queue == 0) {
+#if IS_ENABLED(CONFIG_ZMK_TETRIS_HID_BACKPRESSURE)
+        if (cfg.tx_ack) zmk_tetris_hid_report_sent();
+#endif
+        return true;
+    }
+
+    if (tx_queued >= cfg.tx_queue) {
+        stats.tx_drops++;
+        return false;
+    }
+    if (tx_queued++ == 0) k_work_reschedule(&tx_work, K_MSEC(cfg.tx_interval_ms));
+    stats.tx_queued_max = MAX(stats.tx_queued_max, tx_queued);
+    return true;
+}
+
+/* ==============================
+ * Lock LEDs
+ * ============================== */
+static zmk_hid_indicators_t leds_host;      /* what the host has */
+static zmk_hid_indicators_t leds_reported;  /* what it told the keyboard */
+static struct k_work_delayable led_work;
+
+/* one output report per change, each sent led_latency_ms after it */
+#define LED_QUEUE_MAX 64
+
+static struct {
+    int64_t due;
+    zmk_hid_indicators_t leds;
+} led_queue[LED_QUEUE_MAX];
+static int led_head, led_len;
+
+const struct zmk_event_type zmk_event_zmk_hid_indicators_changed = {
+    .name = "zmk_hid_indicators_changed",
+};
+
+#if IS_ENABLED(CONFIG_ZMK_TETRIS_LED_FLOW_CONTROL) || IS_ENABLED(CONFIG_ZMK_TETRIS_CALIBRATION)
+extern const struct zmk_listener zmk_listener_behavior_tetris;
+
+static void led_report(zmk_hid_indicators_t leds) {
+    struct zmk_hid_indicators_changed_event ev = {
+        .header = {.event = &zmk_event_zmk_hid_indicators_changed},
+        .data = {.indicators = leds},
+    };
+    leds_reported = leds;
+    stats.led_reports++;
+    zmk_listener_behavior_tetris.callback(&ev.header);
+}
+#else
+static void led_report(zmk_hid_indicators_t leds) {
+    leds_reported = leds;
+    stats.led_reports++;
+}
+#endif
+
+static void led_work_handler(struct k_work *work) {
+    ARG_UNUSED(work);
+
+    zmk_hid_indicators_t leds = led_queue[led_head].leds;
+    led_head = (led_head + 1) % LED_QUEUE_MAX;
+    led_len--;
+    if (led_len > 0) {
+        k_work_reschedule(&led_work, K_MSEC(MAX(led_queue[led_head].due - k_uptime_get(), 0)));
+    }
+    led_report(leds);
+}
+
+zmk_hid_indicators_t zmk_hid_indicators_get_current_profile(void) { return leds_reported; }
+
+static void host_scroll_lock(void) {
+    leds_host ^= LED_SCROLL_LOCK;
+    if (cfg.led_mute || led_len == LED_QUEUE_MAX) return;
+
+    int tail = (led_head + led_len) % LED_QUEUE_MAX;
+    led_queue[tail].due = k_uptime_get() + cfg.led_latency_ms;
+    led_queue[tail].leds = leds_host;
+    if (led_len++ == 0) k_work_reschedule(&led_work, K_MSEC(cfg.led_latency_ms));
+}
+
+/* ==============================
+ * Keys
+ * ============================== */
+static uint8_t mods_held;
+static uint8_t keys_held[32];   /* bit per usage id */
+static int64_t last_press_ms;
+
+/* one key event as the host sees it */
+static void host_key(uint32_t encoded, bool pressed) {
+    uint32_t id = ZMK_HID_USAGE_ID(encoded) & 0xFF;
+
+    if (id >= ZMK_HID_USAGE_ID(LCTRL) && id <= ZMK_HID_USAGE_ID(RGUI)) {
+        uint8_t bit = (uint8_t)BIT(id - ZMK_HID_USAGE_ID(LCTRL));
+        if (pressed) mods_held |= bit;
+        else mods_held &= (uint8_t)~bit;
+        editor_key(encoded, pressed);
+        return;
+    }
+    if (!pressed) {
+        keys_held[id / 8] &= (uint8_t)~BIT(id % 8);
+        editor_key(encoded, pressed);
+        return;
+    }
+    if (cfg.key_gap_ms && k_uptime_get() - last_press_ms < cfg.key_gap_ms) {
+        stats.key_drops++;
+        return;
+    }
+    last_press_ms = k_uptime_get();
+    keys_held[id / 8] |= (uint8_t)BIT(id % 8);
+    editor_key(encoded, pressed);
+
+    uint8_t mods = mods_held | SELECT_MODS(encoded);
+    stats.presses++;
+    if ((mods & MOD_LSFT) && id == ZMK_HID_USAGE_ID(MINUS)) stats.blink_chars++;
+    if ((mods & MOD_LCTL) && id == ZMK_HID_USAGE_ID(Z)) stats.undo++;
+    if ((mods & MOD_LCTL) && id == ZMK_HID_USAGE_ID(Y)) stats.redo++;
+    if (encoded == SCROLLLOCK) host_scroll_lock();
+}
+
+int raise_zmk_keycode_state_changed_from_encoded(uint32_t encoded, bool pressed,
+                                                 int64_t timestamp) {
+    ARG_UNUSED(timestamp);
+
+    if (tx_report()) host_key(encoded, pressed);
+    return 0;
+}
+
+#if IS_ENABLED(CONFIG_ZMK_TETRIS_DIRECT_HID)
+/* ==============================
+ * Keyboard report
+ *
+ * The direct HID path edits the report and sends it; the host types
+ * whatever changed since the last report it got.
+ * ============================== */
+#define MOD_USAGE(m) ZMK_HID_USAGE(HID_USAGE_KEY, ZMK_HID_USAGE_ID(LCTRL) + (m))
+
+struct hid_report {
+    uint8_t mods;
+    uint8_t keys[32];   /* bit per usage id */
+};
+
+static struct hid_report report;        /* built by the behavior */
+static struct hid_report report_sent;   /* last one the host got */
+static uint8_t mod_count[8];
+
+static bool report_key(const struct hid_report *r, int id) {
+    return (r->keys[id / 8] & BIT(id % 8)) != 0;
+}
+
+int zmk_hid_register_mods(zmk_mod_flags_t explicit_modifiers) {
+    for (int m = 0; m < 8; m++) {
+        if (!(explicit_modifiers & BIT(m))) continue;
+        mod_count[m]++;
+        report.mods |= (uint8_t)BIT(m);
+    }
+    return 0;
+}
+
+int zmk_hid_unregister_mods(zmk_mod_flags_t explicit_modifiers) {
+    for (int m = 0; m < 8; m++) {
+        if (!(explicit_modifiers & BIT(m)) || mod_count[m] == 0) continue;
+        if (--mod_count[m] == 0) report.mods &= (uint8_t)~BIT(m);
+    }
+    return 0;
+}
+
+int zmk_hid_keyboard_press(zmk_key_t key) {
+    if (is_mod(HID_USAGE_KEY, key)) return zmk_hid_register_mods((zmk_mod_flags_t)BIT(key - 0xE0));
+    report.keys[(key & 0xFF) / 8] |= (uint8_t)BIT(key % 8);
+    return 0;
+}
+
+int zmk_hid_keyboard_release(zmk_key_t key) {
+    if (is_mod(HID_USAGE_KEY, key)) return zmk_hid_unregister_mods((zmk_mod_flags_t)BIT(key - 0xE0));
+    report.keys[(key & 0xFF) / 8] &= (uint8_t)~BIT(key % 8);
+    return 0;
+}
+
+/* releases before presses, modifiers inside the keys they modify */
+int zmk_endpoints_send_report(uint16_t usage_page) {
+    if (usage_page != HID_USAGE_KEY) return -ENOTSUP;
+    if (!tx_report()) return 0;   /* the next report carries the change */
+
+    for (int id = 0; id < 256; id++) {
+        if (report_key(&report_sent, id) && !report_key(&report, id)) {
+            host_key(ZMK_HID_USAGE(HID_USAGE_KEY, id), false);
+        }
+    }
+    for (int m = 0; m < 8; m++) {
+        if ((report_sent.mods & ~report.mods) & BIT(m)) host_key(MOD_USAGE(m), false);
+    }
+    for (int m = 0; m < 8; m++) {
+        if ((report.mods & ~report_sent.mods) & BIT(m)) host_key(MOD_USAGE(m), true);
+    }
+    for (int id = 0; id < 256; id++) {
+        if (!report_key(&report_sent, id) && report_key(&report, id)) {
+            host_key(ZMK_HID_USAGE(HID_USAGE_KEY, id), true);
+        }
+    }
+    report_sent = report;
+    return 0;
+}
+
+static void report_reset(void) {
+    memset(&report, 0, sizeof(report));
+    memset(&report_sent, 0, sizeof(report_sent));
+    memset(mod_count, 0, sizeof(mod_count));
+}
+#else
+static inline void report_reset(void) {}
+#endif
+
+void host_config_set(const struct host_config *config) { cfg = *config; }
+
+void host_reset(const struct host_config *config) {
+    static bool inited;
+    if (!inited) {
+        k_work_init_delayable(&tx_work, tx_work_handler);
+        k_work_init_delayable(&led_work, led_work_handler);
+        inited = true;
+    }
+    k_work_cancel_delayable(&tx_work);
+    k_work_cancel_delayable(&led_work);
+
+    cfg = *config;
+    memset(&stats, 0, sizeof(stats));
+    tx_queued = 0;
+    mods_held = 0;
+    memset(keys_held, 0, sizeof(keys_held));
+    last_press_ms = 0;
+    report_reset();
+    leds_host = leds_reported = 0;
+    led_head = led_len = 0;
+    editor_reset();
+}
+
+const struct host_stats *host_stats(void) { return &stats; }
+
+int host_keys_down(void) {
+    int n = 0;
+    for (int i = 0; i < 32; i++) n += __builtin_popcount(keys_held[i]);
+    return n + __builtin_popcount(mods_held);
+}
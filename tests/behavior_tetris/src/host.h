@@ -0,0 +1,46 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * The host side of the test: the keycode events the behavior raises, or the
+ * keyboard reports of its direct HID path, go out as HID reports and are
+ * typed into the editor model. The transport has an
+ * optional bounded report queue drained at a fixed rate, and acks each sent
+ * report through zmk_tetris_hid_report_sent(). The host answers a Scroll
+ * Lock tap with an LED report after a latency.
+ */
+struct host_config {
+    /* report queue; 0: unbounded, reports are sent at once */
+    int tx_queue;
+    int tx_interval_ms;
+    int tx_per_interval;
+    bool tx_ack;            /* the transport calls zmk_tetris_hid_report_sent() */
+    int led_latency_ms;
+    bool led_mute;          /* the host never reports its LEDs */
+    /* a slow host: presses closer than this to the last one are lost */
+    int key_gap_ms;
+};
+
+struct host_stats {
+    uint32_t reports;
+    uint32_t tx_drops;      /* reports lost to a full queue */
+    int tx_queued_max;
+    uint32_t presses;
+    uint32_t key_drops;     /* presses lost to key_gap_ms */
+    uint32_t undo;          /* Ctrl+Z */
+    uint32_t redo;          /* Ctrl+Y */
+    uint32_t blink_chars;   /* '=' typed */
+    uint32_t led_reports;
+};
+
+void host_reset(const struct host_config *cfg);
+void host_config_set(const struct host_config *cfg);
+const struct host_stats *host_stats(void);
+
+/* keys and modifiers the host sees held down */
+int host_keys_down(void);
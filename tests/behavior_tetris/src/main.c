@@ -0,0 +1,679 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+/* The behavior is built into the test itself, so the tests can compare
+ * the editor with the game state the renderer works from. */
+#include "../../../src/behavior_tetris.c"
+
+#include <string.h>
+
+#include <zephyr/ztest.h>
+
+#include "editor.h"
+#include "host.h"
+#if IS_ENABLED(CONFIG_SETTINGS)
+#include "settings_store.h"
+#endif
+
+#define TETRIS_NODE DT_NODELABEL(tetris)
+
+#define RENDER_TIMEOUT_MS 30000
+#define CALIBRATION_TIMEOUT_MS 60000
+#define SLOW_HOST_KEY_GAP_MS 4
+#define STALLED_HOST_KEY_GAP_MS 40
+#define TEXT_MAX 512
+
+/* immediate reports, every one acked, a host that answers in 5 ms */
+static const struct host_config host_default = {
+    .tx_ack = true,
+    .led_latency_ms = 5,
+};
+
+/* ==============================
+ * Helpers
+ * ============================== */
+static void tetris_cmd(uint32_t cmd) {
+    const struct device *dev = DEVICE_DT_GET(TETRIS_NODE);
+    const struct behavior_driver_api *drv = dev->api;
+    struct zmk_behavior_binding binding = {.behavior_dev = dev->name, .param1 = cmd};
+    struct zmk_behavior_binding_event event = {.timestamp = k_uptime_get()};
+
+    zassert_equal(drv->binding_pressed(&binding, event), ZMK_BEHAVIOR_OPAQUE);
+}
+
+/* commands run and the renderer done; the game keeps running meanwhile */
+static void wait_render_idle(void) {
+    int64_t end = k_uptime_get() + RENDER_TIMEOUT_MS;
+
+    do {
+        k_sleep(K_MSEC(1));
+    } while ((rs.running || k_work_is_pending(&input_work)) && k_uptime_get() < end);
+    zassert_false(rs.running, "renderer still busy after %d ms", RENDER_TIMEOUT_MS);
+}
+
+/* the full frame of the game state */
+static void game_text(char *buf, size_t len) {
+    frame_capture();
+
+    int n = snprintf(buf, len, "%s\n%s\n\n", FRAME_TITLE, score_next);
+    for (int r = 0; r < BOARD_H; r++) {
+        char row[BOARD_W + 2];
+        build_row_string(r, row);
+        n += snprintf(buf + n, len - (size_t)n, "%s\n", row);
+    }
+}
+
+/* Pause the game, let the renderer catch up and compare the editor with a
+ * full frame of the game. */
+static void expect_editor_shows_game(void) {
+    static char want[TEXT_MAX], got[TEXT_MAX];
+
+    if (!paused) tetris_cmd(2);
+    wait_render_idle();
+
+    game_text(want, sizeof(want));
+    zassert_true(editor_text(got, sizeof(got)), "editor text too long");
+    zassert_equal(editor_errors(), 0, "editor: %s", editor_first_error());
+    zassert_equal(strcmp(got, want), 0, "editor:\n%s\ngame:\n%s", got, want);
+}
+
+/* xorshift32: the same presses and gaps on every run */
+static uint32_t rng_state;
+
+static uint32_t rng_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+/* moves and redraws at random gaps, like a player mashing keys */
+static void play(int presses, uint32_t max_gap_ms) {
+    static const uint8_t cmds[] = {10, 11, 10, 11, 12, 13, 14, 15, 16, 13, 10, 11, 3};
+
+    for (int i = 0; i < presses; i++) {
+        k_sleep(K_MSEC(rng_next() % max_gap_ms));
+        tetris_cmd(cmds[rng_next() % ARRAY_SIZE(cmds)]);
+    }
+}
+
+static void set_cell(int r, int c, bool on) {
+    if (on) {
+        board_rows[r] |= (uint16_t)BIT(c);
+        board_cols[c] |= (uint16_t)BIT(r);
+    } else {
+        board_rows[r] &= (uint16_t)~BIT(c);
+        board_cols[c] &= (uint16_t)~BIT(r);
+    }
+    rows_dirty |= (uint16_t)BIT(r);
+}
+
+/* nothing of the game or the renderer runs behind the test's back */
+static void tetris_stop(void) {
+#if IS_ENABLED(CONFIG_ZMK_TETRIS_CALIBRATION)
+    if (cal.active) cal_end();
+#endif
+    stop_render();
+    game_timers_stop();
+}
+
+/* the delays from the devicetree, before any calibration */
+static struct draw_delays dt_delays(void) {
+    const struct behavior_tetris_config *cfg = DEVICE_DT_GET(TETRIS_NODE)->config;
+    return cfg->delays;
+}
+
+static void *tetris_setup(void) {
+#if IS_ENABLED(CONFIG_SETTINGS)
+    zassert_ok(settings_subsys_init());
+#endif
+    return NULL;
+}
+
+/* Each test starts from a reset game typed into an empty editor. */
+static void tetris_before(void *fixture) {
+    ARG_UNUSED(fixture);
+
+    tetris_stop();
+    host_reset(&host_default);
+    invalidate_render_model();
+    draw_delay = dt_delays();
+#if IS_ENABLED(CONFIG_ZMK_TETRIS_LED_FLOW_CONTROL)
+    memset(&flow, 0, sizeof(flow));
+#endif
+#if IS_ENABLED(CONFIG_ZMK_TETRIS_HID_BACKPRESSURE)
+    atomic_set(&hid_pacing, HID_PACING_OFF);
+    atomic_set(&hid_in_flight, 0);
+    atomic_set(&hid_wait_deadline, 0);
+#endif
+    rng_state = 0x7e715u;
+
+    tetris_cmd(0);
+    wait_render_idle();
+}
+
+ZTEST_SUITE(behavior_tetris, NULL, tetris_setup, tetris_before, NULL, NULL);
+
+/* ==============================
+ * Render equivalence
+ * ============================== */
+ZTEST(behavior_tetris, test_reset_types_the_game) {
+    expect_editor_shows_game();
+}
+
+ZTEST(behavior_tetris, test_play_keeps_editor_in_sync) {
+    for (int round = 0; round < 5; round++) {
+        play(30, 400);
+        expect_editor_shows_game();
+        tetris_cmd(2);
+    }
+}
+
+ZTEST(behavior_tetris, test_reset_and_redraw_over_a_known_editor) {
+    play(20, 300);
+    tetris_cmd(0);
+    expect_editor_shows_game();
+
+    tetris_cmd(2);
+    tetris_cmd(3);
+    expect_editor_shows_game();
+}
+
+/* clearing the editor stops the game and leaves the editor empty */
+ZTEST(behavior_tetris, test_clear_leaves_editor_empty) {
+    static char got[TEXT_MAX];
+
+    play(10, 200);
+    tetris_cmd(1);
+    wait_render_idle();
+    k_sleep(K_MSEC(1000));
+    wait_render_idle();
+
+    zassert_true(editor_text(got, sizeof(got)), "editor text too long");
+    zassert_equal(editor_errors(), 0, "editor: %s", editor_first_error());
+    zassert_equal(strcmp(got, ""), 0, "editor not empty:\n%s", got);
+}
+
+/* Four rows are cleared with junk above them: the blink is typed at the
+ * default timing, its phases are flipped with undo/redo, and the rows
+ * above drop into place. */
+ZTEST(behavior_tetris, test_line_clear_blinks_and_collapses) {
+    const int top = BOARD_H - 4;
+
+    tetris_cmd(2);
+    wait_render_idle();
+    for (int r = top; r < BOARD_H; r++) {
+        for (int c = 1; c < BOARD_W; c++) set_cell(r, c, true);
+    }
+    for (int r = top - 3; r < top; r++) {
+        for (int c = 1; c < BOARD_W; c++) set_cell(r, c, ((r * 7 + c * 3) % 4) == 0);
+    }
+    request_diff_render();
+    wait_render_idle();
+
+    /* a vertical I over the empty column, dropped as soon as the game runs */
+    mark_piece_dirty();
+    falling.type = TET_I;
+    falling.rot = 1;
+    falling.x = -2;
+    falling.y = 0;
+    mark_piece_dirty();
+    tetris_cmd(2);
+    tetris_cmd(15);
+
+    bool blink_seen = false;
+    for (int t = 0; t < 2000 && !blink_seen; t++) {
+        k_sleep(K_MSEC(1));
+        for (int r = top; r < BOARD_H; r++) {
+            blink_seen |= (strcmp(editor_line(BOARD_TOP_LINE_INDEX + r), "========== ") == 0);
+        }
+    }
+    zassert_true(blink_seen, "blink never on screen");
+    zassert_true(host_stats()->blink_chars > 0);
+
+    k_sleep(K_MSEC(1000));
+    wait_render_idle();
+    zassert_equal(lines_cleared_total, 4);
+    zassert_true(host_stats()->undo > 0 && host_stats()->redo > 0,
+                 "blink flip not typed (undo %u redo %u)", host_stats()->undo,
+                 host_stats()->redo);
+    expect_editor_shows_game();
+}
+
+/* ==============================
+ * Cancel
+ * ============================== */
+/* Redraws and moves are cut at random points, some with Shift held for a
+ * selection or, on the direct HID path, a release still held back: the
+ * cancel lets go of every key, and a reset retypes the game over whatever
+ * was left. */
+ZTEST(behavior_tetris, test_cancel_releases_every_key) {
+    int held_at_cut = 0;
+
+    for (int i = 0; i < 40; i++) {
+        tetris_cmd((i % 2) ? 3 : 10 + rng_next() % 7);
+        k_sleep(K_MSEC(1 + rng_next() % 120));
+
+        held_at_cut += (host_keys_down() > 0);
+        stop_render();
+        zassert_equal(host_keys_down(), 0, "cut %d: %d keys still down", i, host_keys_down());
+
+        tetris_cmd(0);
+        expect_editor_shows_game();
+    }
+    zassert_true(held_at_cut > 0, "no cut with a key down");
+}
+
+/* ==============================
+ * Flow control
+ * ============================== */
+#if IS_ENABLED(CONFIG_ZMK_TETRIS_LED_FLOW_CONTROL)
+ZTEST(behavior_tetris, test_led_flow_paced_by_host) {
+    play(60, 400);
+    expect_editor_shows_game();
+    zassert_false(flow.broken);
+    zassert_true(host_stats()->led_reports > 0);
+}
+
+ZTEST(behavior_tetris, test_led_flow_falls_back_on_silent_host) {
+    struct host_config cfg = host_default;
+    cfg.led_mute = true;
+    host_config_set(&cfg);
+
+    tetris_cmd(3);
+    wait_render_idle();
+    zassert_true(flow.broken);
+
+    play(30, 400);
+    expect_editor_shows_game();
+}
+#endif
+
+#if IS_ENABLED(CONFIG_ZMK_TETRIS_HID_BACKPRESSURE)
+/* a BLE-like link: 2 reports per 15 ms connection interval, 8 queued */
+static const struct host_config host_ble = {
+    .tx_queue = 8,
+    .tx_interval_ms = 15,
+    .tx_per_interval = 2,
+    .tx_ack = true,
+    .led_latency_ms = 5,
+};
+
+ZTEST(behavior_tetris, test_hid_backpressure_keeps_queue_below_high_water) {
+    zassert_equal(atomic_get(&hid_pacing), HID_PACING_ON);
+    host_config_set(&host_ble);
+
+    play(60, 400);
+    expect_editor_shows_game();
+    zassert_equal(host_stats()->tx_drops, 0);
+    zassert_true(host_stats()->tx_queued_max <= HID_HIGH_WATER, "%d reports queued",
+                 host_stats()->tx_queued_max);
+}
+
+/* a transport that never acks never holds the renderer: a redraw takes as
+ * long as with every report acked at once */
+ZTEST(behavior_tetris, test_hid_backpressure_off_without_acks) {
+    struct host_config cfg = host_default;
+
+    tetris_cmd(2);
+    wait_render_idle();
+
+    int64_t start = k_uptime_get();
+    tetris_cmd(3);
+    wait_render_idle();
+    int64_t acked_ms = k_uptime_get() - start;
+
+    cfg.tx_ack = false;
+    host_config_set(&cfg);
+    atomic_set(&hid_pacing, HID_PACING_OFF);
+
+    start = k_uptime_get();
+    tetris_cmd(3);
+    wait_render_idle();
+    int64_t unacked_ms = k_uptime_get() - start;
+
+    zassert_equal(atomic_get(&hid_pacing), HID_PACING_OFF);
+    zassert_true(unacked_ms <= acked_ms + 2, "redraw %d ms without acks, %d ms with",
+                 (int)unacked_ms, (int)acked_ms);
+    expect_editor_shows_game();
+}
+
+/* acks that stop switch pacing off instead of stalling every batch */
+ZTEST(behavior_tetris, test_hid_backpressure_latches_off_when_acks_stop) {
+    struct host_config cfg = host_ble;
+    host_config_set(&cfg);
+    play(10, 200);
+
+    cfg.tx_ack = false;
+    host_config_set(&cfg);
+    tetris_cmd(3);
+    wait_render_idle();
+    zassert_equal(atomic_get(&hid_pacing), HID_PACING_BROKEN);
+
+    tetris_cmd(3);
+    wait_render_idle();
+}
+#endif
+
+/* ==============================
+ * Calibration
+ * ============================== */
+#if IS_ENABLED(CONFIG_ZMK_TETRIS_CALIBRATION)
+static void calibration_wait(void) {
+    int64_t end = k_uptime_get() + CALIBRATION_TIMEOUT_MS;
+
+    do {
+        k_sleep(K_MSEC(10));
+    } while (cal.active && k_uptime_get() < end);
+    zassert_false(cal.active, "calibration still running after %d ms", CALIBRATION_TIMEOUT_MS);
+}
+
+static void calibrate(void) {
+    tetris_cmd(4);
+    calibration_wait();
+}
+
+static bool delays_equal(const struct draw_delays *a, const struct draw_delays *b) {
+    return a->char_ms == b->char_ms && a->enter_ms == b->enter_ms && a->nav_ms == b->nav_ms &&
+           a->action_ms == b->action_ms;
+}
+
+/* a host that keeps up with anything: every level passes */
+ZTEST(behavior_tetris, test_calibration_reaches_fastest_level) {
+    const struct draw_delays base = draw_delay;
+    const uint8_t pct = cal_levels_pct[ARRAY_SIZE(cal_levels_pct) - 1];
+
+    calibrate();
+    zassert_true(cal.found);
+    zassert_equal(draw_delay.char_ms, cal_scale(base.char_ms, pct));
+    zassert_equal(draw_delay.enter_ms, cal_scale(base.enter_ms, pct));
+    zassert_equal(draw_delay.nav_ms, cal_scale(base.nav_ms, pct));
+    zassert_equal(draw_delay.action_ms, cal_scale(base.action_ms, pct));
+    expect_editor_shows_game();
+}
+
+/* A host that loses presses closer together than its key gap: calibration
+ * stops at the last level it kept up with, cleans up after the failed run,
+ * and the game types correctly at the delays it found. */
+ZTEST(behavior_tetris, test_calibration_stops_where_host_drops_keys) {
+    const struct draw_delays base = draw_delay;
+    const uint8_t pct = cal_levels_pct[ARRAY_SIZE(cal_levels_pct) - 1];
+    struct host_config cfg = host_default;
+    cfg.key_gap_ms = SLOW_HOST_KEY_GAP_MS;
+    host_config_set(&cfg);
+
+    calibrate();
+    zassert_true(cal.found);
+    zassert_true(host_stats()->key_drops > 0);
+    zassert_true(draw_delay.char_ms < base.char_ms, "no level passed but the first");
+    zassert_true(draw_delay.char_ms > cal_scale(base.char_ms, pct), "the fastest level passed");
+
+    expect_editor_shows_game();
+    tetris_cmd(2);
+    play(20, 300);
+    expect_editor_shows_game();
+}
+
+/* A host too slow for the first level, which loses the run's own cleanup
+ * keys too: once it recovers, the redraw after the failed run wipes what
+ * was left on the last line. */
+ZTEST(behavior_tetris, test_calibration_wipes_a_failed_run) {
+    const struct draw_delays base = draw_delay;
+    struct host_config cfg = host_default;
+    cfg.key_gap_ms = STALLED_HOST_KEY_GAP_MS;
+    host_config_set(&cfg);
+
+    tetris_cmd(4);
+    do {
+        k_sleep(K_MSEC(1));
+    } while (!rs.running);
+    do {
+        k_sleep(K_MSEC(1));
+    } while (rs.running);
+    host_config_set(&host_default);
+
+    calibration_wait();
+    zassert_false(cal.found);
+    zassert_true(host_stats()->key_drops > 0);
+    zassert_true(delays_equal(&draw_delay, &base));
+    expect_editor_shows_game();
+}
+
+/* a host that never reports its LEDs: no level passes, the delays stay */
+ZTEST(behavior_tetris, test_calibration_keeps_delays_without_leds) {
+    const struct draw_delays base = draw_delay;
+    struct host_config cfg = host_default;
+    cfg.led_mute = true;
+    host_config_set(&cfg);
+
+    calibrate();
+    zassert_false(cal.found);
+    zassert_true(delays_equal(&draw_delay, &base));
+    expect_editor_shows_game();
+}
+
+/* a control command aborts it: the delays from before, the editor retyped */
+ZTEST(behavior_tetris, test_calibration_cancel_restores_delays) {
+    const struct draw_delays base = draw_delay;
+
+    tetris_cmd(4);
+    k_sleep(K_MSEC(300));
+    zassert_true(cal.active);
+
+    tetris_cmd(3);
+    wait_render_idle();
+    zassert_false(cal.active);
+    zassert_true(delays_equal(&draw_delay, &base));
+    expect_editor_shows_game();
+}
+
+#if IS_ENABLED(CONFIG_SETTINGS)
+/* the calibrated delays are saved, and loading settings puts them back
+ * over the DT ones; a record with a zero delay is ignored */
+ZTEST(behavior_tetris, test_calibrated_delays_saved_and_loaded) {
+    const struct draw_delays dt = dt_delays();
+    struct draw_delays saved, zero = {0};
+
+    store_reset();
+    calibrate();
+    zassert_true(cal.found);
+    zassert_equal(store_read("tetris/delays", &saved, sizeof(saved)), sizeof(saved));
+    zassert_true(delays_equal(&saved, &draw_delay));
+
+    draw_delay = dt;
+    zassert_ok(settings_load());
+    zassert_true(delays_equal(&draw_delay, &saved));
+
+    zassert_ok(settings_save_one("tetris/delays", &zero, sizeof(zero)));
+    draw_delay = dt;
+    zassert_ok(settings_load());
+    zassert_true(delays_equal(&draw_delay, &dt));
+}
+#endif
+#endif
+
+/* ==============================
+ * Game board
+ *
+ * The bitboard against the plain cell walks it replaced, on random boards.
+ * ============================== */
+#define BOARD_RUNS 20000
+
+static void board_before(void *fixture) {
+    ARG_UNUSED(fixture);
+
+    tetris_stop();
+    board_wipe();
+    rng_state = 0xb0a2du;
+}
+
+static void board_after(void *fixture) {
+    ARG_UNUSED(fixture);
+
+    /* a test may hold the renderer busy */
+    rs.running = false;
+    tetris_stop();
+}
+
+ZTEST_SUITE(behavior_tetris_board, NULL, NULL, board_before, board_after, NULL);
+
+/* fill_pct of the cells set, at random */
+static void random_board(int fill_pct) {
+    for (int r = 0; r < BOARD_H; r++) {
+        for (int c = 0; c < BOARD_W; c++) set_cell(r, c, (int)(rng_next() % 100) < fill_pct);
+    }
+}
+
+/* every cell of the piece on the board and free */
+static bool can_place_cells(uint8_t type, uint8_t rot, int x, int y) {
+    uint16_t m = SHAPE[type][rot & 3];
+
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++) {
+            if (!(m & BIT_AT(r, c))) continue;
+
+            int bx = x + c, by = y + r;
+            if (bx < 0 || bx >= BOARD_W || by < 0 || by >= BOARD_H) return false;
+            if (board_rows[by] & BIT(bx)) return false;
+        }
+    }
+    return true;
+}
+
+ZTEST(behavior_tetris_board, test_can_place_matches_cell_walk) {
+    for (int run = 0; run < BOARD_RUNS; run++) {
+        random_board(run % 60);
+
+        for (uint8_t type = 0; type < TET_COUNT; type++) {
+            for (uint8_t rot = 0; rot < 4; rot++) {
+                for (int x = -6; x <= BOARD_W + 2; x++) {
+                    for (int y = -6; y <= BOARD_H + 2; y++) {
+                        zassert_equal(can_place(type, rot, x, y), can_place_cells(type, rot, x, y),
+                                      "run %d: type %d rot %d at (%d, %d)", run, type, rot, x, y);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* board_cols rebuilt from the rows */
+static void expect_cols_match_rows(int run) {
+    for (int c = 0; c < BOARD_W; c++) {
+        uint16_t col = 0;
+        for (int r = 0; r < BOARD_H; r++) {
+            if (board_rows[r] & BIT(c)) col |= (uint16_t)BIT(r);
+        }
+        zassert_equal(board_cols[c], col, "run %d: column %d is %03x, rows say %03x", run, c,
+                      board_cols[c], col);
+    }
+}
+
+/* Pieces dropped on boards with nearly full rows over a one-column well:
+ * the landing row from the column index against a fall one row at a time,
+ * and the column index against the rows after every lock and clear. */
+ZTEST(behavior_tetris_board, test_drop_and_clear_keep_columns) {
+    int multi_clears = 0;
+
+    for (int run = 0; run < BOARD_RUNS / 10; run++) {
+        int floor = (int)(rng_next() % (BOARD_H - 2)) + 2;
+        int well = (int)(rng_next() % BOARD_W);
+
+        board_wipe();
+        for (int r = 0; r < BOARD_H; r++) {
+            for (int c = 0; c < BOARD_W; c++) {
+                bool on = (r >= floor) ? (c != well || rng_next() % 5 == 0) : (rng_next() % 100 < 10);
+                set_cell(r, c, on);
+            }
+        }
+        expect_cols_match_rows(run);
+
+        for (int n = 0; n < 8; n++) {
+            /* every third piece a vertical I down the well */
+            uint8_t type = (uint8_t)(rng_next() % TET_COUNT);
+            uint8_t rot = (uint8_t)(rng_next() % 4);
+            int x = (int)(rng_next() % (BOARD_W + 3)) - 3;
+            if (n % 3 == 0) {
+                type = TET_I;
+                rot = 1;
+                x = well - 2;
+            }
+
+            int y = -3;
+            while (y < BOARD_H && !can_place(type, rot, x, y)) y++;
+            if (y == BOARD_H) continue;
+
+            int fall = 0;
+            while (can_place(type, rot, x, y + fall + 1)) fall++;
+            zassert_equal(drop_distance(type, rot, x, y), fall,
+                          "run %d: type %d rot %d at (%d, %d)", run, type, rot, x, y);
+
+            falling.type = type;
+            falling.rot = rot;
+            falling.x = x;
+            falling.y = y + fall;
+            lock_falling();
+            expect_cols_match_rows(run);
+
+            uint16_t full = detect_full_lines();
+            if (!full) continue;
+            apply_line_clear(full);
+            expect_cols_match_rows(run);
+            if (popcount16(full) > 1) multi_clears++;
+        }
+    }
+    zassert_true(multi_clears > 100, "only %d multi-row clears", multi_clears);
+}
+
+/* the board rows as the renderer would type them now */
+static void board_text(char rows[BOARD_H][BOARD_W + 2]) {
+    frame_capture();
+    for (int r = 0; r < BOARD_H; r++) build_row_string(r, rows[r]);
+}
+
+/* The renderer is held busy, so only the test takes the dirty rows: after
+ * moves, gravity, locks, clear blinks, spawns and game overs, every row
+ * whose text changed since it last looked must be marked dirty. It looks
+ * after most steps and lets the dirty rows pile up over several steps in
+ * between. */
+ZTEST(behavior_tetris_board, test_dirty_rows_cover_changed_rows) {
+    static const uint8_t cmds[] = {10, 11, 10, 11, 12, 13, 14, 15, 15, 16};
+    static char shown[BOARD_H][BOARD_W + 2], now[BOARD_H][BOARD_W + 2];
+
+    reset_game();
+    rs.running = true;
+    board_text(shown);
+    memcpy(render_prev, shown, sizeof(render_prev));
+    rows_dirty = 0;
+    schedule_gravity_idle();
+
+    for (int step = 0; step < 2000; step++) {
+        /* full rows under one with a gap now and then: the next lock
+         * clears them */
+        if (step % 50 == 0 && !clearing && falling.y + 4 < BOARD_H - 3) {
+            int gap = (int)(rng_next() % BOARD_W);
+            for (int r = BOARD_H - 3; r < BOARD_H; r++) {
+                for (int c = 0; c < BOARD_W; c++) set_cell(r, c, r > BOARD_H - 3 || c != gap);
+            }
+        }
+
+        if (rng_next() % 2) tetris_cmd(cmds[rng_next() % ARRAY_SIZE(cmds)]);
+        k_sleep(K_MSEC(rng_next() % 100));
+
+        board_text(now);
+        for (int r = 0; r < BOARD_H; r++) {
+            zassert_true(strcmp(now[r], shown[r]) == 0 || (rows_dirty & BIT(r)),
+                         "step %d: row %d went from '%s' to '%s', not dirty", step, r, shown[r],
+                         now[r]);
+        }
+        if (rng_next() % 3 == 0) continue;
+
+        /* typed: the blink waits for the renderer to show its phase */
+        memcpy(shown, now, sizeof(shown));
+        memcpy(render_prev, now, sizeof(render_prev));
+        rows_dirty = 0;
+        clear_resume();
+    }
+    zassert_true(lines_cleared_total >= 20, "only %d lines cleared", lines_cleared_total);
+}
@@ -0,0 +1,93 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/settings/settings.h>
+#include <zephyr/sys/util.h>
+
+#include "settings_store.h"
+
+#define STORE_RECORDS 4
+#define STORE_NAME_MAX 32
+#define STORE_VALUE_MAX 32
+
+static struct record {
+    char name[STORE_NAME_MAX];
+    uint8_t value[STORE_VALUE_MAX];
+    size_t len;
+} records[STORE_RECORDS];
+static int n_records;
+
+static struct record *record_find(const char *name) {
+    for (int i = 0; i < n_records; i++) {
+        if (strcmp(records[i].name, name) == 0) return &records[i];
+    }
+    return NULL;
+}
+
+static ssize_t record_read(void *cb_arg, void *data, size_t len) {
+    const struct record *rec = cb_arg;
+    size_t n = MIN(len, rec->len);
+
+    memcpy(data, rec->value, n);
+    return (ssize_t)n;
+}
+
+static int store_load(struct settings_store *cs, const struct settings_load_arg *arg) {
+    ARG_UNUSED(cs);
+
+    for (int i = 0; i < n_records; i++) {
+        settings_call_set_handler(records[i].name, records[i].len, record_read, &records[i], arg);
+    }
+    return 0;
+}
+
+/* an empty value deletes the record */
+static int store_save(struct settings_store *cs, const char *name, const char *value,
+                      size_t val_len) {
+    ARG_UNUSED(cs);
+
+    struct record *rec = record_find(name);
+    if (val_len == 0) {
+        if (rec) *rec = records[--n_records];
+        return 0;
+    }
+    if (strlen(name) >= STORE_NAME_MAX || val_len > STORE_VALUE_MAX) return -ENOMEM;
+    if (!rec) {
+        if (n_records == STORE_RECORDS) return -ENOMEM;
+        rec = &records[n_records++];
+        strcpy(rec->name, name);
+    }
+    memcpy(rec->value, value, val_len);
+    rec->len = val_len;
+    return 0;
+}
+
+static const struct settings_store_itf store_itf = {
+    .csi_load = store_load,
+    .csi_save = store_save,
+};
+
+static struct settings_store store = {
+    .cs_itf = &store_itf,
+};
+
+int settings_backend_init(void) {
+    settings_dst_register(&store);
+    settings_src_register(&store);
+    return 0;
+}
+
+void store_reset(void) {
+    n_records = 0;
+}
+
+int store_read(const char *name, void *buf, size_t len) {
+    const struct record *rec = record_find(name);
+    if (!rec) return -ENOENT;
+
+    memcpy(buf, rec->value, MIN(len, rec->len));
+    return (int)rec->len;
+}
@@ -0,0 +1,15 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+#pragma once
+
+#include <stddef.h>
+
+/*
+ * In-memory settings backend (CONFIG_SETTINGS_CUSTOM): what the behavior
+ * saves is kept in a few records and handed back by settings_load().
+ */
+void store_reset(void);
+
+/* the value saved under `name`: its length, or -ENOENT */
+int store_read(const char *name, void *buf, size_t len);